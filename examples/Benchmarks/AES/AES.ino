@@ -0,0 +1,93 @@
+/******************************************************************************
+   This sketch measures the CPU cycles LMIC spends on the LoRaWAN crypto
+   operations, with the AES engine it was built with:
+    - The MIC of a 51-byte uplink (B0 block + 64-byte frame)
+    - The AES-CTR encryption of the 51-byte payload
+    - The decryption of a 32-byte join-accept (with CFList)
+
+   Select the engine with USE_ORIGINAL_AES or USE_IDEETRON_AES, and the
+   table placement with LMIC_AES_TABLES_IN_RAM (see lmic/config.h or pass
+   them as compiler flags), and run it once for every combination.
+   Examples/Tests/AESTest verifies that they all produce the same results.
+*/
+#include <uNodeOpen.hpp>
+#include <vendor/LMIC-Arduino/lmic.h>
+
+ADC_MODE(ADC_VCC);
+
+/**
+ * How many times to repeat every operation
+ */
+#define BENCH_ROUNDS            100
+
+/**
+ * uNode library configuration
+ */
+uNodeConfig unode_config = {
+  .lora = {
+    .mode = LORA_DISABLED
+  },
+  .logging = LOG_DISABLED
+};
+
+const uint8_t key[16] = {
+  0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+uint8_t frame[64];
+
+/**
+ * Return the average cycles of the given operation, setting up the key
+ * and the auxiliary block the same way LMIC does before every call
+ */
+uint32_t benchmark(uint8_t mode, uint8_t aux0, uint8_t * data, uint16_t len) {
+  uint32_t total = 0;
+
+  for (uint16_t i = 0; i < BENCH_ROUNDS; ++i) {
+    uint32_t start = ESP.getCycleCount();
+    memcpy(AESkey, key, 16);
+    memset(AESaux, 0, 16);
+    AESaux[0] = aux0;
+    AESaux[15] = (mode == AES_CTR) ? 1 : len;
+    os_aes(mode, data, len);
+    total += ESP.getCycleCount() - start;
+    yield();
+  }
+
+  return total / BENCH_ROUNDS;
+}
+
+/**
+ * Sketch setup
+ */
+void setup() {
+  uNode.setup();
+  for (uint8_t i = 0; i < sizeof(frame); ++i) frame[i] = i;
+
+  Serial.println();
+#if defined(USE_ORIGINAL_AES)
+  Serial.print("Engine: original (T-table)");
+#else
+  Serial.print("Engine: Ideetron");
+#endif
+#if defined(LMIC_AES_TABLES_IN_RAM)
+  Serial.println(", tables in RAM");
+#else
+  Serial.println(", tables in flash");
+#endif
+
+  uint32_t mic = benchmark(AES_MIC, 0x49, frame, 64);
+  uint32_t ctr = benchmark(AES_CTR, 0x01, frame + 13, 51);
+  uint32_t join = benchmark(AES_ENC, 0x00, frame, 32);
+
+  Serial.printf("MIC (64 bytes): %u cycles, %u us\n", mic, mic / ESP.getCpuFreqMHz());
+  Serial.printf("CTR (51 bytes): %u cycles, %u us\n", ctr, ctr / ESP.getCpuFreqMHz());
+  Serial.printf("Join-accept (32 bytes): %u cycles, %u us\n", join, join / ESP.getCpuFreqMHz());
+}
+
+/**
+ * Sketch loop
+ */
+void loop() {
+  delay(1000);
+}
@@ -0,0 +1,148 @@
+/******************************************************************************
+   This sketch compares the CPU cycles of turning a DHT22 reading into a LoRa
+   payload with the float functions of the DHT library, against their fixed
+   point (hundredths) versions:
+    - The temperature and humidity, from the raw tenths the sensor sends
+    - The temperature in Fahrenheit
+    - The heat index
+    - Packing all of them as int16_t hundredths for the payload
+
+   It runs over BENCH_READINGS synthetic readings, covering both heat index
+   equations, and prints the largest difference between the two versions.
+   No sensor needs to be connected.
+
+   For the code size, set BENCH_PIPELINE to BENCH_FLOAT and then BENCH_FIXED,
+   and compare the sketch sizes it prints (or the IDE reports).
+*/
+#include <uNodeOpen.hpp>
+#include <uNode/libraries/DHT.hpp>
+
+ADC_MODE(ADC_VCC);
+
+#define BENCH_FLOAT             1
+#define BENCH_FIXED             2
+
+/**
+ * Which pipelines to build in
+ */
+#define BENCH_PIPELINE          (BENCH_FLOAT | BENCH_FIXED)
+
+/**
+ * How many readings to convert
+ */
+#define BENCH_READINGS          256
+
+/**
+ * uNode library configuration
+ */
+uNodeConfig unode_config = {
+  .lora = {
+    .mode = LORA_DISABLED
+  },
+  .logging = LOG_DISABLED
+};
+
+/**
+ * The payload fields, in hundredths
+ */
+struct Payload {
+  int16_t temperature;
+  int16_t temperatureF;
+  int16_t humidity;
+  int16_t heatIndex;
+};
+
+DHT dht(102, DHT22);
+
+int16_t rawTemperature[BENCH_READINGS];
+uint16_t rawHumidity[BENCH_READINGS];
+Payload floatPayload[BENCH_READINGS];
+Payload fixedPayload[BENCH_READINGS];
+
+#if BENCH_PIPELINE & BENCH_FLOAT
+/**
+ * The float version, decoding the raw values like DHT::lastTemperature()
+ */
+uint32_t runFloat() {
+  uint32_t start = ESP.getCycleCount();
+
+  for (uint16_t i = 0; i < BENCH_READINGS; ++i) {
+    float t = rawTemperature[i] * 0.1;
+    float h = rawHumidity[i] * 0.1;
+    float f = dht.convertCtoF(t);
+    float hi = dht.computeHeatIndex(t, h);
+
+    floatPayload[i].temperature = round(t * 100);
+    floatPayload[i].temperatureF = round(f * 100);
+    floatPayload[i].humidity = round(h * 100);
+    floatPayload[i].heatIndex = round(hi * 100);
+  }
+
+  return (ESP.getCycleCount() - start) / BENCH_READINGS;
+}
+#endif
+
+#if BENCH_PIPELINE & BENCH_FIXED
+/**
+ * The fixed point version, decoding the raw values like DHT::lastTemperatureCenti()
+ */
+uint32_t runFixed() {
+  uint32_t start = ESP.getCycleCount();
+
+  for (uint16_t i = 0; i < BENCH_READINGS; ++i) {
+    int16_t t = rawTemperature[i] * 10;
+    int16_t h = rawHumidity[i] * 10;
+
+    fixedPayload[i].temperature = t;
+    fixedPayload[i].temperatureF = dht.convertCtoFCenti(t);
+    fixedPayload[i].humidity = h;
+    fixedPayload[i].heatIndex = dht.computeHeatIndexCenti(t, h);
+  }
+
+  return (ESP.getCycleCount() - start) / BENCH_READINGS;
+}
+#endif
+
+/**
+ * Sketch setup
+ */
+void setup() {
+  uNode.setup();
+
+  // Temperatures from -10.0 to 45.0 and humidities from 5.0 to 100.0 (in tenths)
+  randomSeed(1);
+  for (uint16_t i = 0; i < BENCH_READINGS; ++i) {
+    rawTemperature[i] = random(-100, 451);
+    rawHumidity[i] = random(50, 1001);
+  }
+
+  Serial.println();
+  Serial.printf("Sketch size: %u bytes\n", ESP.getSketchSize());
+
+#if BENCH_PIPELINE & BENCH_FLOAT
+  uint32_t floatCycles = runFloat();
+  Serial.printf("Float: %u cycles, %u us per reading\n", floatCycles, floatCycles / ESP.getCpuFreqMHz());
+#endif
+#if BENCH_PIPELINE & BENCH_FIXED
+  uint32_t fixedCycles = runFixed();
+  Serial.printf("Fixed point: %u cycles, %u us per reading\n", fixedCycles, fixedCycles / ESP.getCpuFreqMHz());
+#endif
+
+#if BENCH_PIPELINE == (BENCH_FLOAT | BENCH_FIXED)
+  int16_t worst = 0;
+  for (uint16_t i = 0; i < BENCH_READINGS; ++i) {
+    int16_t diff = abs(floatPayload[i].temperatureF - fixedPayload[i].temperatureF);
+    if (diff > worst) worst = diff;
+    diff = abs(floatPayload[i].heatIndex - fixedPayload[i].heatIndex);
+    if (diff > worst) worst = diff;
+  }
+  Serial.printf("Largest difference: %d hundredths\n", worst);
+#endif
+}
+
+/**
+ * Sketch loop
+ */
+void loop() {
+  delay(1000);
+}
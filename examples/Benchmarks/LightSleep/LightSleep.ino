@@ -0,0 +1,143 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis - TLab.gr
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+
+/******************************************************************************
+   This sketch compares the ESP8266 current draw per LoRa uplink, with and
+   without light sleep while LMIC waits for the RX windows.
+
+   It sends BENCH_UPLINKS packets with light sleep disabled, then the same
+   number with light sleep enabled. For every uplink it measures the wall-clock
+   time between queueing the packet and the "sent" callback (using the RTC
+   clock, which keeps running during light sleep) and the time spent in light
+   sleep. The charge is then estimated from the typical ESP8266 currents below.
+   The radio draws the same in both modes, so it's not included.
+
+   Fill in your ABP keys before running it.
+*/
+#include <uNodeOpen.hpp>
+#include <uNode/peripherals/Power.hpp>
+
+extern "C" {
+  #include "user_interface.h"
+}
+
+ADC_MODE(ADC_VCC);
+
+/**
+ * Typical ESP8266 current (in mA) at 80 MHz with the WiFi off, and in
+ * forced light sleep
+ */
+#define CURRENT_ACTIVE_MA       15.0
+#define CURRENT_LIGHT_SLEEP_MA  0.9
+
+/**
+ * How many uplinks to send in every mode
+ */
+#define BENCH_UPLINKS           3
+
+/**
+ * uNode library configuration
+ */
+uNodeConfig unode_config = {
+  .lora = {
+    .mode = LORA_TTN_ABP,
+    .activation = {
+      .abp = {
+        .appKey = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        .netKey = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        .devAddr = 0x00000000
+      }
+    }
+  },
+  .logging = LOG_DISABLED
+};
+
+volatile uint8_t sent;
+
+void packetSent(int status, uint8_t * downstream_data, uint8_t size) {
+  sent = 1;
+}
+
+/**
+ * Wall-clock time in microseconds, based on the RTC clock
+ */
+uint32_t rtcMicros() {
+  return ((uint64_t)system_get_rtc_time() * system_rtc_clock_cali_proc()) >> 12;
+}
+
+/**
+ * Send BENCH_UPLINKS packets and return the estimated charge (in uC) per uplink
+ */
+float benchmark(uint8_t lightSleep) {
+  float charge = 0;
+  uNode.enableLightSleep(lightSleep);
+
+  for (uint8_t i = 0; i < BENCH_UPLINKS; ++i) {
+    // Respect the duty cycle before measuring
+    delay(uNode.nextTxTime());
+
+    uint32_t sleepStart = Power.sleepStats.time;
+    uint32_t wallStart = rtcMicros();
+
+    sent = 0;
+    uNode.sendLoRa("bench", 5, packetSent);
+    while (!sent) {
+      uNode.step();
+    }
+
+    uint32_t wall = rtcMicros() - wallStart;
+    uint32_t slept = Power.sleepStats.time - sleepStart;
+    uint32_t awake = wall - slept;
+    charge += (awake * CURRENT_ACTIVE_MA + slept * CURRENT_LIGHT_SLEEP_MA) / 1000.0;
+
+    Serial.printf("  #%d: %u ms total, %u ms in light sleep\n", i + 1, wall / 1000, slept / 1000);
+  }
+
+  return charge / BENCH_UPLINKS;
+}
+
+/**
+ * Sketch setup
+ */
+void setup() {
+  uNode.setup();
+
+  Serial.println();
+  Serial.println("Light sleep disabled:");
+  float chargeAwake = benchmark(0);
+  Serial.println("Light sleep enabled:");
+  float chargeSleep = benchmark(1);
+
+  Serial.printf("Charge per uplink without light sleep: %d uC\n", (int)chargeAwake);
+  Serial.printf("Charge per uplink with light sleep: %d uC\n", (int)chargeSleep);
+  Serial.printf("Saving: %d %%\n", (int)(100 * (chargeAwake - chargeSleep) / chargeAwake));
+}
+
+/**
+ * Sketch loop
+ */
+void loop() {
+  uNode.deepSleep(3600);
+}
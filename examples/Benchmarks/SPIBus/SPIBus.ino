@@ -0,0 +1,175 @@
+/******************************************************************************
+   This sketch measures the SPI bus shared by the radio and the GPIO
+   expansion chip, through `SPIBus`:
+    - Single register reads (transactions per second) on each chip
+    - 64-byte bursts (bytes per second) on each chip
+    - Register reads alternating between the two chips, as when LMIC and the
+      expansion pins are used together, against selecting them the way it
+      was done before (`SPI.beginTransaction()` with new settings and
+      `digitalWrite()` on the chip select every time)
+
+   It reads the radio version register first, which should be 0x12 for the
+   SX1276. LoRa is not started.
+*/
+#include <uNodeOpen.hpp>
+#include <uNode/peripherals/SPIBus.hpp>
+
+ADC_MODE(ADC_VCC);
+
+/**
+ * How many transactions to run for every measurement
+ */
+#define BENCH_ROUNDS            2000
+
+/**
+ * Length of the bursts
+ */
+#define BENCH_BURST             64
+
+/**
+ * uNode library configuration
+ */
+uNodeConfig unode_config = {
+  .lora = {
+    .mode = LORA_DISABLED
+  },
+  .logging = LOG_DISABLED
+};
+
+// SX1276 registers (write bit clear)
+#define RADIO_REG_FIFO          0x00
+#define RADIO_REG_VERSION       0x42
+
+// MCP23S08 read opcode and port register
+#define GPIO_OPCODE_READ        ((0x21 << 1) | 1)
+#define GPIO_REG_GPIO           0x09
+
+/**
+ * Read a radio register
+ */
+uint8_t radioRead(uint8_t reg) {
+  SPIBus.select(SPI_DEVICE_RADIO);
+  SPI.transfer(reg);
+  uint8_t value = SPI.transfer(0);
+  SPIBus.deselect(SPI_DEVICE_RADIO);
+  return value;
+}
+
+/**
+ * Read the port of the GPIO chip
+ */
+uint8_t gpioRead() {
+  SPIBus.select(SPI_DEVICE_GPIO);
+  SPI.transfer(GPIO_OPCODE_READ);
+  SPI.transfer(GPIO_REG_GPIO);
+  uint8_t value = SPI.transfer(0);
+  SPIBus.deselect(SPI_DEVICE_GPIO);
+  return value;
+}
+
+/**
+ * The same reads, re-configuring the bus every time
+ */
+uint8_t radioReadUnmanaged(uint8_t reg) {
+  SPI.beginTransaction(SPISettings(10000000, MSBFIRST, SPI_MODE0));
+  digitalWrite(UPIN_RFM_EN, LOW);
+  SPI.transfer(reg);
+  uint8_t value = SPI.transfer(0);
+  digitalWrite(UPIN_RFM_EN, HIGH);
+  SPI.endTransaction();
+  return value;
+}
+
+uint8_t gpioReadUnmanaged() {
+  SPI.beginTransaction(SPISettings(12000000, MSBFIRST, SPI_MODE0));
+  digitalWrite(UPIN_GPIO, LOW);
+  SPI.transfer(GPIO_OPCODE_READ);
+  SPI.transfer(GPIO_REG_GPIO);
+  uint8_t value = SPI.transfer(0);
+  digitalWrite(UPIN_GPIO, HIGH);
+  SPI.endTransaction();
+  return value;
+}
+
+/**
+ * Read a burst from one of the chips. The radio FIFO address increments,
+ * the GPIO chip keeps reading the port.
+ */
+void burst(uint8_t device, uint8_t * buffer) {
+  SPIBus.select(device);
+  if (device == SPI_DEVICE_RADIO) {
+    SPI.transfer(RADIO_REG_FIFO);
+  } else {
+    SPI.transfer(GPIO_OPCODE_READ);
+    SPI.transfer(GPIO_REG_GPIO);
+  }
+  for (uint8_t i = 0; i < BENCH_BURST; ++i) {
+    buffer[i] = SPI.transfer(0);
+  }
+  SPIBus.deselect(device);
+}
+
+/**
+ * Print the rate of `count` operations in `elapsed` micro seconds
+ */
+void report(const char * name, uint32_t count, const char * unit, uint32_t elapsed) {
+  Serial.printf("%s: %u %s/s (%u ns each)\n", name, (uint32_t)(count * 1000000ULL / elapsed),
+                unit, (uint32_t)(elapsed * 1000ULL / count));
+}
+
+/**
+ * Sketch setup
+ */
+void setup() {
+  uint8_t buffer[BENCH_BURST];
+  uint32_t start;
+
+  uNode.setup();
+
+  // Power both chips. readPort() starts the GPIO chip, the radio only needs
+  // its chip select.
+  uNode.enablePeripherals();
+  uNode.readPort();
+  SPIBus.setDevice(SPI_DEVICE_RADIO, UPIN_RFM_EN, 10000000);
+
+  Serial.println();
+  Serial.printf("Radio version: 0x%02x\n", radioRead(RADIO_REG_VERSION));
+
+  start = micros();
+  for (uint16_t i = 0; i < BENCH_ROUNDS; ++i) radioRead(RADIO_REG_VERSION);
+  report("Radio register reads", BENCH_ROUNDS, "transactions", micros() - start);
+
+  start = micros();
+  for (uint16_t i = 0; i < BENCH_ROUNDS; ++i) gpioRead();
+  report("GPIO register reads", BENCH_ROUNDS, "transactions", micros() - start);
+
+  start = micros();
+  for (uint16_t i = 0; i < BENCH_ROUNDS / 16; ++i) burst(SPI_DEVICE_RADIO, buffer);
+  report("Radio FIFO bursts", (uint32_t)(BENCH_ROUNDS / 16) * BENCH_BURST, "bytes", micros() - start);
+
+  start = micros();
+  for (uint16_t i = 0; i < BENCH_ROUNDS / 16; ++i) burst(SPI_DEVICE_GPIO, buffer);
+  report("GPIO port bursts", (uint32_t)(BENCH_ROUNDS / 16) * BENCH_BURST, "bytes", micros() - start);
+  yield();
+
+  start = micros();
+  for (uint16_t i = 0; i < BENCH_ROUNDS / 2; ++i) {
+    radioRead(RADIO_REG_VERSION);
+    gpioRead();
+  }
+  report("Alternating, SPIBus", BENCH_ROUNDS, "transactions", micros() - start);
+
+  start = micros();
+  for (uint16_t i = 0; i < BENCH_ROUNDS / 2; ++i) {
+    radioReadUnmanaged(RADIO_REG_VERSION);
+    gpioReadUnmanaged();
+  }
+  report("Alternating, unmanaged", BENCH_ROUNDS, "transactions", micros() - start);
+}
+
+/**
+ * Sketch loop
+ */
+void loop() {
+  delay(1000);
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+   This sketch compares the bytes per sample needed for sending batches of
+   sensor readings with the time-series encoder, against sending the raw
+   structures with `uNode.sendLoRa<T>`.
+
+   It generates BENCH_SAMPLES synthetic (timestamp, value) readings for a few
+   typical signals, packs them in as many uplinks as needed (each one up to
+   `uNode.maxPayload()` bytes), decodes them back to verify the round-trip and
+   prints the results. Nothing is transmitted.
+*/
+#include <uNodeOpen.hpp>
+#include <uNode/libraries/TimeSeries.hpp>
+
+ADC_MODE(ADC_VCC);
+
+/**
+ * How many samples to generate for every signal
+ */
+#define BENCH_SAMPLES           240
+
+/**
+ * uNode library configuration
+ */
+uNodeConfig unode_config = {
+  .lora = {
+    .mode = LORA_TTN_ABP,
+    .activation = {
+      .abp = {
+        .appKey = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        .netKey = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        .devAddr = 0x00000000
+      }
+    }
+  },
+  .logging = LOG_DISABLED
+};
+
+/**
+ * The structure that would be sent with `uNode.sendLoRa<T>`
+ */
+struct Sample {
+  uint32_t timestamp;
+  float value;
+};
+
+uint32_t timestamps[BENCH_SAMPLES];
+float values[BENCH_SAMPLES];
+
+/**
+ * Generate the samples of the given signal
+ */
+void generate(uint8_t signal) {
+  uint32_t now = 1539000000;
+  float value = 21.0;
+
+  for (uint16_t i = 0; i < BENCH_SAMPLES; ++i) {
+    switch (signal) {
+      case 0: // Temperature with 0.1 resolution, every 60 seconds
+        now += 60;
+        value += (int)random(-2, 3) * 0.1;
+        values[i] = round(value * 10) / 10;
+        break;
+
+      case 1: // Slowly rising value, every 60 +/- 1 seconds
+        now += 59 + random(0, 3);
+        values[i] = value + (i / 8) * 0.5;
+        break;
+
+      case 2: // Noise, at random intervals
+        now += random(1, 1000);
+        values[i] = random(0, 10000) / 7.0;
+        break;
+    }
+    timestamps[i] = now;
+  }
+}
+
+/**
+ * Encode all the samples and return the total number of bytes
+ */
+size_t benchmark(uint8_t maxPayload, uint16_t & uplinks) {
+  uint8_t buffer[LORA_MAX_PAYLOAD];
+  size_t bytes = 0, pos = 0;
+  uplinks = 0;
+
+  while (pos < BENCH_SAMPLES) {
+    TimeSeriesEncoder encoder(buffer, maxPayload);
+    size_t consumed = encoder.add(timestamps + pos, values + pos, BENCH_SAMPLES - pos);
+
+    // Verify that the samples decode back to the same values
+    TimeSeriesDecoder decoder(buffer, encoder.length());
+    uint32_t timestamp;
+    float value;
+    for (size_t i = 0; decoder.next(timestamp, value); ++i) {
+      if ((timestamp != timestamps[pos + i]) || (value != values[pos + i])) {
+        Serial.printf("  Mismatch on sample %d\n", pos + i);
+      }
+    }
+
+    pos += consumed;
+    bytes += encoder.length();
+    uplinks++;
+  }
+
+  return bytes;
+}
+
+/**
+ * Sketch setup
+ */
+void setup() {
+  const char * names[] = { "Temperature", "Rising", "Noise" };
+  uNode.setup();
+  randomSeed(ESP.getVcc());
+
+  uint8_t maxPayload = uNode.maxPayload();
+  uint16_t rawPerUplink = maxPayload / sizeof(Sample);
+  Serial.println();
+  Serial.printf("Maximum payload: %d bytes\n", maxPayload);
+  Serial.printf("Raw: %d bytes/sample, %d samples/uplink\n", sizeof(Sample), rawPerUplink);
+
+  for (uint8_t signal = 0; signal < 3; ++signal) {
+    uint16_t uplinks;
+    generate(signal);
+    size_t bytes = benchmark(maxPayload, uplinks);
+
+    Serial.printf("%s: %d.%02d bytes/sample, %d uplinks (raw: %d uplinks)\n",
+      names[signal],
+      bytes / BENCH_SAMPLES, (bytes % BENCH_SAMPLES) * 100 / BENCH_SAMPLES,
+      uplinks, (BENCH_SAMPLES + rawPerUplink - 1) / rawPerUplink
+    );
+  }
+}
+
+/**
+ * Sketch loop
+ */
+void loop() {
+  uNode.deepSleep(3600);
+}
@@ -60,6 +60,10 @@ void setup() {
   Wire.beginTransmission(0x1234);
   Wire.write(0x1234);
   Wire.endTransmission();
+
+  // Both pins are on the GPIO expansion, so the bytes are clocked out by its
+  // I2C engine. Use `Wire.setClock()` to change the speed.
+  Serial.printf("I2C clock: %u Hz\n", Wire.getClock());
 }
 
 /**
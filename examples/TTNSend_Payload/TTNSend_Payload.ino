@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis - TLab.gr
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#include <uNodeOpen.hpp>
+#include <uNode/libraries/Payload.hpp>
+
+/**
+ * We are using the ADC to measure the battery voltage. If you are using the ADC
+ * in your project, comment-out the following line.
+ */
+ADC_MODE(ADC_VCC);
+
+/**
+ * uNode library configuration
+ */
+uNodeConfig unode_config = {
+  .lora = {
+    .mode = LORA_TTN_ABP,
+    .activation = {
+      .abp = {
+        .appKey = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        .netKey = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        .devAddr = 0x00000000
+      }
+    }
+  }
+};
+
+/**
+ * The payload schema. A plain structure with the same fields would take 12
+ * bytes (including padding), while the packed payload is only 3 bytes.
+ */
+typedef PayloadSchema<
+  PayloadUInt<12>,          // Battery voltage (mV)
+  PayloadScaled<0, 10, 10>, // Uptime until send (seconds, 0.1s steps)
+  PayloadBool               // GPIO pin state
+> SensorPayload;
+
+/**
+ * The field names used in the generated decoder
+ */
+const char * const SensorPayloadNames[] = {
+  "vcc", "uptime", "pin"
+};
+
+/**
+ * Helper function to shut down the chip when the packet is sent
+ */
+void packetSent(int status, uint8_t * downstream_data, uint8_t size) {
+  Serial.println("Packet Sent");
+
+  // Go to sleep for 30 seconds
+  // (Will reset the sketch when waking up from sleep)
+  uNode.deepSleep(30);
+}
+
+/**
+ * Sketch setup
+ */
+void setup() {
+  uNode.setup();
+
+  // Make the GPIO a general purpose input
+  pinMode(D0, INPUT_PULLUP);
+
+  // IMPORTANT : When you are testing this sketch, remember to connect D0 to
+  //             the DTR pin instead of the GND. Connecting it to GND will make
+  //             the device boot into an invalid mode! DTR is pulled LOW after
+  //             boot and therefore behaves as a safer alternative to GND.
+
+  // Print the decoder to paste in the "Payload Formats" section of the
+  // application in the TTN console
+  SensorPayload::writeDecoder(Serial, SensorPayloadNames);
+
+  // Encode and send the packet
+  SensorPayload::Packet packet;
+  SensorPayload::encode(packet,
+    ESP.getVcc(),
+    millis() / 1000.0,
+    digitalRead(D0) == HIGH
+  );
+  uNode.sendLoRa(packet, packetSent);
+}
+
+/**
+ * Sketch loop
+ */
+void loop() {
+  uNode.step();
+}
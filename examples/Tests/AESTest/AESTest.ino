@@ -0,0 +1,123 @@
+/******************************************************************************
+   This sketch verifies the AES engine LMIC was built with, against known
+   answers:
+    - FIPS-197 (appendix C.1) block encryption, as used for the join-accept
+    - RFC4493 (examples 2 to 4) AES-CMAC, as used for the join MIC
+    - A LoRaWAN frame MIC (B0 block prepended) and FRMPayload encryption
+      (AES-CTR), cross-checked with OpenSSL
+
+    Both engines (USE_IDEETRON_AES and USE_ORIGINAL_AES, see lmic/config.h)
+    and both table placements (LMIC_AES_TABLES_IN_RAM) must pass, which
+    makes them interchangeable.
+*/
+#include <uNodeOpen.hpp>
+#include <vendor/LMIC-Arduino/lmic.h>
+
+ADC_MODE(ADC_VCC);
+
+/**
+ * uNode library configuration
+ */
+uNodeConfig unode_config = {
+  .lora = {
+    .mode = LORA_DISABLED
+  }
+};
+
+const uint8_t FIPS_KEY[16] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+const uint8_t FIPS_PLAIN[16] = {
+  0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+const uint8_t FIPS_CIPHER[16] = {
+  0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+};
+
+const uint8_t RFC_KEY[16] = {
+  0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+const uint8_t RFC_MESSAGE[64] = {
+  0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+  0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+  0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+  0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+/**
+ * LoRaWAN uplink of DevAddr 0x26011BDA, FCnt 1 and a 20-byte payload
+ * (i * 7 + 3), using the RFC4493 key
+ */
+const uint8_t FRAME_B0[16] = {
+  0x49, 0x00, 0x00, 0x00, 0x00, 0x00, 0xda, 0x1b, 0x01, 0x26, 0x01, 0x00, 0x00, 0x00, 0x00, 0x14
+};
+const uint8_t FRAME_A1[16] = {
+  0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0xda, 0x1b, 0x01, 0x26, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01
+};
+const uint8_t FRAME_CIPHER[20] = {
+  0x81, 0xf9, 0x28, 0x77, 0x0b, 0xe9, 0x39, 0xae, 0x73, 0x12,
+  0x1b, 0xef, 0x17, 0x1f, 0xc1, 0x20, 0x75, 0x10, 0x7a, 0x46
+};
+
+uint8_t failures = 0;
+
+void check(const char * name, bool passed) {
+  Serial.printf("%s: %s\n", name, passed ? "PASS" : "FAIL");
+  if (!passed) failures++;
+}
+
+/**
+ * Sketch setup
+ */
+void setup() {
+  uint8_t buf[64];
+  uNode.setup();
+
+  Serial.println();
+#if defined(USE_ORIGINAL_AES)
+  Serial.print("Engine: original (T-table)");
+#else
+  Serial.print("Engine: Ideetron");
+#endif
+#if defined(LMIC_AES_TABLES_IN_RAM)
+  Serial.println(", tables in RAM");
+#else
+  Serial.println(", tables in flash");
+#endif
+
+  // Block encryption
+  memcpy(buf, FIPS_PLAIN, 16);
+  memcpy(AESkey, FIPS_KEY, 16);
+  os_aes(AES_ENC, buf, 16);
+  check("FIPS-197 ECB", memcmp(buf, FIPS_CIPHER, 16) == 0);
+
+  // CMAC without prefix block
+  memcpy(buf, RFC_MESSAGE, 64);
+  memcpy(AESkey, RFC_KEY, 16);
+  check("RFC4493 CMAC 16 bytes", os_aes(AES_MIC | AES_MICNOAUX, buf, 16) == 0x070a16b4);
+  memcpy(AESkey, RFC_KEY, 16);
+  check("RFC4493 CMAC 40 bytes", os_aes(AES_MIC | AES_MICNOAUX, buf, 40) == 0xdfa66747);
+  memcpy(AESkey, RFC_KEY, 16);
+  check("RFC4493 CMAC 64 bytes", os_aes(AES_MIC | AES_MICNOAUX, buf, 64) == 0x51f0bebf);
+
+  // Frame MIC, with the B0 block prepended
+  for (uint8_t i = 0; i < 20; ++i) buf[i] = i * 7 + 3;
+  memcpy(AESkey, RFC_KEY, 16);
+  memcpy(AESaux, FRAME_B0, 16);
+  check("LoRaWAN MIC", os_aes(AES_MIC, buf, 20) == 0x41c705b6);
+
+  // Payload encryption
+  memcpy(AESkey, RFC_KEY, 16);
+  memcpy(AESaux, FRAME_A1, 16);
+  os_aes(AES_CTR, buf, 20);
+  check("LoRaWAN CTR", memcmp(buf, FRAME_CIPHER, 20) == 0);
+
+  Serial.printf("%d failure(s)\n", failures);
+}
+
+/**
+ * Sketch loop
+ */
+void loop() {
+  delay(1000);
+}
@@ -46,6 +46,9 @@
     This Test/Demo verifies correct operation of the MCP23S08. Pin 10 on the chip is D2, pin 11 is D3, ... and pin 17 is D9.
     The Test needs pins D2(=10) connected to D3(=11), D4 TO D5, D6 to D7 and D8 to D9.
 
+    The change test watches the input pins with uNode.watchPort() and uNode.portChanges(), and
+    compares the time it takes to notice a change with polling the pins with uNode.digitalRead().
+
     Contributed 13/01/2019, Gijs Mos, Sensemakers Amsterdam, www.sensemakersams.org
 */
 #include <uNodeOpen.hpp>
@@ -74,12 +77,13 @@ const uint8_t nPins = 4;
 // Forward declarations
 unsigned functionalTest( const uint8_t a[], const uint8_t b[] );
 unsigned stressTest( const uint8_t a[], const uint8_t b[] );
+unsigned changeTest( const uint8_t a[], const uint8_t b[] );
 
 /**
    Sketch setup
 */
 void setup() {
-  unsigned functionalErrors, stressErrors;
+  unsigned functionalErrors, stressErrors, changeErrors;
 
   uNode.setup();                    // Initialize the uNode library
   Serial.println("GPIO (MCP23S08) test. Pin D2 should be connected to D3, D4 to D5, D6 to D7, D8 to D9.");
@@ -102,6 +106,15 @@ void setup() {
   } else
     Serial.println( "Stress tests passed." );
 
+  changeErrors = changeTest( evenPins, oddPins );
+  changeErrors += changeTest( oddPins, evenPins );
+  if (changeErrors) {
+    Serial.print("** ");
+    Serial.print( changeErrors );
+    Serial.println( " change detection errors found." );
+  } else
+    Serial.println( "Change detection tests passed." );
+
   Serial.println("\nReset uNode for another pass...");
 }
 
@@ -241,3 +254,98 @@ unsigned stressTest( const uint8_t a[], const uint8_t b[] ) {
 
   return errors;
 }
+
+/*
+   Change detection test suite
+*/
+unsigned changeTest( const uint8_t a[], const uint8_t b[] ) {
+  unsigned errors = 0;
+  uint8_t mask = 0;
+  uint8_t state, changed;
+
+  // a[] pins drive the watched b[] pins.
+  for ( int i = 0; i < nPins; i++ ) {
+    uNode.pinMode( a[i], OUTPUT );
+    uNode.digitalWrite( a[i], LOW );
+    uNode.pinMode( b[i], INPUT );
+    mask |= 1 << ( b[i] - D2 );
+  }
+  delay(1);
+  uNode.watchPort( mask );
+
+  for ( int i = 0; i < nPins; i++ ) {
+    uint8_t bit = 1 << ( b[i] - D2 );
+
+    // ------
+    // Rising edge on a single pin
+    uNode.digitalWrite( a[i], HIGH );
+    delay(1);
+    changed = uNode.portChanges( &state );
+    if ( ( changed != bit ) || !( state & bit ) ) {
+      Serial.print( b[i] );
+      Serial.println( " expected to change to HIGH (E020)." );
+      errors++;
+    }
+
+    // ------
+    // Nothing else changed
+    if ( uNode.portChanges( &state ) != 0 ) {
+      Serial.print( b[i] );
+      Serial.println( " expected no more changes (E021)." );
+      errors++;
+    }
+
+    // ------
+    // A pulse between two calls is reported, with the current state. It
+    // goes back to HIGH, so only the latched change (INTF / INTCAP) shows it.
+    uNode.digitalWrite( a[i], LOW );
+    uNode.digitalWrite( a[i], HIGH );
+    changed = uNode.portChanges( &state );
+    if ( ( changed != bit ) || !( state & bit ) ) {
+      Serial.print( b[i] );
+      Serial.println( " expected to report the pulse and be HIGH (E022)." );
+      errors++;
+    }
+
+    // ------
+    // A change is still reported after a digitalRead() cleared the interrupt
+    uNode.digitalWrite( a[i], LOW );
+    delay(1);
+    if ( uNode.digitalRead( b[i] ) != LOW ) {
+      Serial.print( b[i] );
+      Serial.println( " expected to read LOW (E023)." );
+      errors++;
+    }
+    changed = uNode.portChanges( &state );
+    if ( ( changed != bit ) || ( state & bit ) ) {
+      Serial.print( b[i] );
+      Serial.println( " expected to report the change after a read and be LOW (E024)." );
+      errors++;
+    }
+  }
+
+  // ------
+  // Compare the time of a pass without changes with polling the pins
+  uint32_t start = micros();
+  for ( int loops = 0; loops < 1000; loops++ ) {
+    changed |= uNode.portChanges();
+  }
+  uint32_t watching = micros() - start;
+
+  start = micros();
+  for ( int loops = 0; loops < 1000; loops++ ) {
+    for ( int i = 0; i < nPins; i++ ) {
+      changed |= uNode.digitalRead( b[i] );
+    }
+  }
+  uint32_t polling = micros() - start;
+
+  Serial.print( "Watching: " );
+  Serial.print( watching / 1000.0 );
+  Serial.print( " us per pass, polling: " );
+  Serial.print( polling / 1000.0 );
+  Serial.println( " us per pass." );
+
+  uNode.watchPort( 0 );
+  return errors;
+}
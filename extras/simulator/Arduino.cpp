@@ -0,0 +1,132 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#include <stdarg.h>
+#include <Arduino.h>
+#include <SPI.h>
+#include "uNode/Pinout.hpp"
+#include "Simulator.hpp"
+
+HardwareSerial Serial;
+EspClass ESP;
+SPIClass SPI;
+
+unsigned long millis() {
+  return (uint32_t)(Sim.uptime() / 1000);
+}
+
+unsigned long micros() {
+  return (uint32_t)Sim.uptime();
+}
+
+void delay(unsigned long ms) {
+  Sim.advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  Sim.advance(us);
+}
+
+void yield() {
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin == UPIN_VBUS_EN) {
+    Sim.setVBus(value == HIGH);
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+}
+
+void detachInterrupt(uint8_t pin) {
+}
+
+int HardwareSerial::printf(const char * format, ...) {
+  if (Sim.serial == NULL) return 0;
+  va_list args;
+  va_start(args, format);
+  int len = vfprintf(Sim.serial, format, args);
+  va_end(args);
+  return len;
+}
+
+size_t HardwareSerial::print(const char * str) {
+  return printf("%s", str);
+}
+
+size_t HardwareSerial::print(long value) {
+  return printf("%ld", value);
+}
+
+size_t HardwareSerial::println(const char * str) {
+  return printf("%s\n", str);
+}
+
+size_t HardwareSerial::println(long value) {
+  return printf("%ld\n", value);
+}
+
+size_t HardwareSerial::write(uint8_t data) {
+  return printf("%c", data);
+}
+
+void HardwareSerial::flush() {
+  if (Sim.serial != NULL) fflush(Sim.serial);
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t * data, size_t size) {
+  if ((offset * 4 + size) > sizeof(Sim.rtcMemory)) return false;
+  memcpy(data, &Sim.rtcMemory[offset], size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t * data, size_t size) {
+  if ((offset * 4 + size) > sizeof(Sim.rtcMemory)) return false;
+  memcpy(&Sim.rtcMemory[offset], data, size);
+  return true;
+}
+
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(Sim.uptime() * Sim.power.cpuMHz);
+}
+
+uint8_t EspClass::getCpuFreqMHz() {
+  return Sim.power.cpuMHz;
+}
+
+uint16_t EspClass::getVcc() {
+  return Sim.vcc;
+}
+
+void EspClass::deepSleep(uint64_t time_us, RFMode mode) {
+  Sim.deepSleep(time_us, mode != WAKE_RF_DISABLED);
+}
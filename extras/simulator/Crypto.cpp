@@ -0,0 +1,186 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#include <string.h>
+#include "Crypto.hpp"
+
+static uint8_t sbox[256];
+static uint8_t rsbox[256];
+
+static inline uint8_t xtime(uint8_t x) {
+  return (x << 1) ^ ((x & 0x80) ? 0x1B : 0x00);
+}
+
+static inline uint8_t rotl8(uint8_t x, uint8_t n) {
+  return (x << n) | (x >> (8 - n));
+}
+
+static uint8_t mul(uint8_t a, uint8_t b) {
+  uint8_t p = 0;
+  while (b) {
+    if (b & 1) p ^= a;
+    a = xtime(a);
+    b >>= 1;
+  }
+  return p;
+}
+
+/**
+ * Build the S-box and its inverse, walking GF(2^8) with the generator 3
+ */
+static void initTables() {
+  if (sbox[0]) return;
+  uint8_t p = 1, q = 1;
+  do {
+    p = p ^ xtime(p);
+    q ^= q << 1;
+    q ^= q << 2;
+    q ^= q << 4;
+    if (q & 0x80) q ^= 0x09;
+    sbox[p] = 0x63 ^ q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4);
+  } while (p != 1);
+  sbox[0] = 0x63;
+  for (int i = 0; i < 256; ++i) {
+    rsbox[sbox[i]] = i;
+  }
+}
+
+SimAES::SimAES(const uint8_t key[16]) {
+  initTables();
+  memcpy(roundKeys, key, 16);
+
+  uint8_t rcon = 1;
+  for (int i = 16; i < 176; i += 4) {
+    uint8_t t[4] = { roundKeys[i - 4], roundKeys[i - 3], roundKeys[i - 2], roundKeys[i - 1] };
+    if ((i % 16) == 0) {
+      uint8_t first = t[0];
+      t[0] = sbox[t[1]] ^ rcon;
+      t[1] = sbox[t[2]];
+      t[2] = sbox[t[3]];
+      t[3] = sbox[first];
+      rcon = xtime(rcon);
+    }
+    for (int j = 0; j < 4; ++j) {
+      roundKeys[i + j] = roundKeys[i + j - 16] ^ t[j];
+    }
+  }
+}
+
+/**
+ * Encrypt a block; the state is column-major, like the byte order of the block
+ */
+void SimAES::encrypt(uint8_t s[16]) const {
+  uint8_t t[16];
+  for (int i = 0; i < 16; ++i) s[i] ^= roundKeys[i];
+
+  for (int round = 1; round <= 10; ++round) {
+    // SubBytes and ShiftRows
+    for (int c = 0; c < 4; ++c) {
+      for (int r = 0; r < 4; ++r) {
+        t[c * 4 + r] = sbox[s[((c + r) % 4) * 4 + r]];
+      }
+    }
+
+    // MixColumns, except in the last round
+    for (int c = 0; c < 4; ++c) {
+      uint8_t * a = &t[c * 4];
+      if (round < 10) {
+        uint8_t all = a[0] ^ a[1] ^ a[2] ^ a[3];
+        uint8_t a0 = a[0];
+        a[0] ^= all ^ xtime(a[0] ^ a[1]);
+        a[1] ^= all ^ xtime(a[1] ^ a[2]);
+        a[2] ^= all ^ xtime(a[2] ^ a[3]);
+        a[3] ^= all ^ xtime(a[3] ^ a0);
+      }
+      for (int r = 0; r < 4; ++r) {
+        s[c * 4 + r] = a[r] ^ roundKeys[round * 16 + c * 4 + r];
+      }
+    }
+  }
+}
+
+/**
+ * Decrypt a block, with the straight inverse cipher
+ */
+void SimAES::decrypt(uint8_t s[16]) const {
+  uint8_t t[16];
+  for (int i = 0; i < 16; ++i) s[i] ^= roundKeys[160 + i];
+
+  for (int round = 9; round >= 0; --round) {
+    // InvShiftRows and InvSubBytes
+    for (int c = 0; c < 4; ++c) {
+      for (int r = 0; r < 4; ++r) {
+        t[c * 4 + r] = rsbox[s[((c + 4 - r) % 4) * 4 + r]];
+      }
+    }
+
+    // AddRoundKey, then InvMixColumns except in the last round
+    for (int c = 0; c < 4; ++c) {
+      uint8_t a[4];
+      for (int r = 0; r < 4; ++r) {
+        a[r] = t[c * 4 + r] ^ roundKeys[round * 16 + c * 4 + r];
+      }
+      for (int r = 0; r < 4; ++r) {
+        s[c * 4 + r] = (round == 0) ? a[r] :
+          mul(a[r], 14) ^ mul(a[(r + 1) % 4], 11) ^ mul(a[(r + 2) % 4], 13) ^ mul(a[(r + 3) % 4], 9);
+      }
+    }
+  }
+}
+
+/**
+ * Shift a 128-bit value left by one bit, reducing with the CMAC polynomial
+ */
+static void subkey(uint8_t k[16]) {
+  uint8_t carry = k[0] & 0x80;
+  for (int i = 0; i < 15; ++i) {
+    k[i] = (k[i] << 1) | (k[i + 1] >> 7);
+  }
+  k[15] = (k[15] << 1) ^ (carry ? 0x87 : 0x00);
+}
+
+void SimAES::cmac(const uint8_t * data, size_t len, uint8_t mac[16]) const {
+  uint8_t k[16] = { 0 };
+  encrypt(k);
+  subkey(k);
+
+  // All the blocks but the last one
+  memset(mac, 0, 16);
+  size_t blocks = (len + 15) / 16;
+  if (blocks == 0) blocks = 1;
+  for (size_t b = 0; b + 1 < blocks; ++b) {
+    for (int i = 0; i < 16; ++i) mac[i] ^= data[b * 16 + i];
+    encrypt(mac);
+  }
+
+  // The last block is XORed with K1 if complete, padded and XORed with K2 if not
+  size_t last = (blocks - 1) * 16;
+  size_t rest = len - last;
+  if (rest < 16) subkey(k);
+  for (size_t i = 0; i < 16; ++i) {
+    uint8_t byte = (i < rest) ? data[last + i] : (i == rest) ? 0x80 : 0x00;
+    mac[i] ^= byte ^ k[i];
+  }
+  encrypt(mac);
+}
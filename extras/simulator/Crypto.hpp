@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#ifndef SIM_CRYPTO_H
+#define SIM_CRYPTO_H
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * AES-128 in both directions, and AES-CMAC (RFC 4493)
+ *
+ * The network server needs the inverse cipher to build join-accepts, which
+ * the AES engines of LMIC don't have. Keeping the server independent of
+ * LMIC's crypto also means that a bug in either one shows up as a MIC error.
+ */
+class SimAES {
+public:
+
+  SimAES(const uint8_t key[16]);
+
+  /**
+   * Encrypt or decrypt a single 16-byte block in place
+   */
+  void encrypt(uint8_t block[16]) const;
+  void decrypt(uint8_t block[16]) const;
+
+  /**
+   * The AES-CMAC of `len` bytes of `data`
+   */
+  void cmac(const uint8_t * data, size_t len, uint8_t mac[16]) const;
+
+private:
+
+  uint8_t   roundKeys[176];
+
+};
+
+#endif
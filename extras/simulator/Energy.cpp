@@ -0,0 +1,141 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#include <string.h>
+#include "Energy.hpp"
+
+/**
+ * Radio operating modes (RegOpMode & 0x07)
+ */
+#define RADIO_SLEEP             0x00
+#define RADIO_TX                0x03
+
+SimEnergy::SimEnergy() {
+  profile.cpu80 = 15.0;         // ESP8266 modem-sleep
+  profile.cpu160 = 23.0;
+  profile.lightSleep = 0.9;
+  profile.deepSleep = 0.02;
+  profile.boot = 70.0;          // RF calibration after waking up
+  profile.bootTime = 120000;
+  profile.wifi = 55.0;          // Station, receiving
+  profile.vbus = 0.05;
+  profile.gpio = 0.001;         // MCP23S08 standby
+  profile.loraSleep = 0.0002;
+  profile.loraStandby = 1.6;
+  profile.loraRx = 11.5;        // SX1276 RX, 125 kHz
+  profile.loraTx = 87.0;        // SX1276 TX on PA_BOOST, as LMIC configures it
+  reset();
+}
+
+void SimEnergy::reset() {
+  memset(mAus, 0, sizeof(mAus));
+  memset(us, 0, sizeof(us));
+}
+
+void SimEnergy::account(const SimPowerState & state, uint64_t dt) {
+  float cpu, wifi = 0, vbus = 0, gpio = 0, lora = 0;
+
+  switch (state.cpu) {
+    case SIM_CPU_LIGHT_SLEEP: cpu = profile.lightSleep; break;
+    case SIM_CPU_DEEP_SLEEP:  cpu = profile.deepSleep; break;
+    case SIM_CPU_BOOT:        cpu = profile.boot; break;
+    default:                  cpu = (state.cpuMHz == 160) ? profile.cpu160 : profile.cpu80; break;
+  }
+  if (state.wifi && (state.cpu == SIM_CPU_ACTIVE)) {
+    wifi = profile.wifi;
+  }
+
+  // The radio and the expander are powered from VBus
+  if (state.vbus) {
+    vbus = profile.vbus;
+    gpio = profile.gpio;
+    switch (state.radio) {
+      case RADIO_SLEEP: lora = profile.loraSleep; break;
+      case RADIO_TX:    lora = profile.loraTx; break;
+      default:          lora = (state.radio > RADIO_TX) ? profile.loraRx : profile.loraStandby; break;
+    }
+  }
+
+  mAus[SIM_RAIL_CPU] += (double)cpu * dt;
+  mAus[SIM_RAIL_WIFI] += (double)wifi * dt;
+  mAus[SIM_RAIL_VBUS] += (double)vbus * dt;
+  mAus[SIM_RAIL_GPIO] += (double)gpio * dt;
+  mAus[SIM_RAIL_LORA] += (double)lora * dt;
+  us[state.cpu] += dt;
+}
+
+double SimEnergy::charge(SIM_RAIL_t rail) const {
+  return mAus[rail] / 3600e6;
+}
+
+double SimEnergy::charge() const {
+  double total = 0;
+  for (int i = 0; i < SIM_RAILS; ++i) {
+    total += mAus[i];
+  }
+  return total / 3600e6;
+}
+
+uint64_t SimEnergy::time(SIM_CPU_STATE_t cpu) const {
+  return us[cpu];
+}
+
+uint64_t SimEnergy::time() const {
+  uint64_t total = 0;
+  for (int i = 0; i < SIM_CPU_STATES; ++i) {
+    total += us[i];
+  }
+  return total;
+}
+
+double SimEnergy::averageCurrent() const {
+  uint64_t total = time();
+  return total ? (charge() * 3600e6 / total) : 0;
+}
+
+double SimEnergy::projectDays(double capacity) const {
+  double current = averageCurrent();
+  return (current > 0) ? (capacity / current / 24) : 0;
+}
+
+void SimEnergy::print(FILE * out) const {
+  static const char * rails[SIM_RAILS] = { "CPU", "WiFi", "VBus", "GPIO", "LoRa" };
+  static const char * states[SIM_CPU_STATES] = { "Active", "Light sleep", "Deep sleep", "Boot" };
+  double total = charge();
+  uint64_t elapsed = time();
+
+  fprintf(out, "%-12s %14s %8s\n", "Rail", "Charge (mAh)", "Share");
+  for (int i = 0; i < SIM_RAILS; ++i) {
+    fprintf(out, "%-12s %14.3f %7.1f%%\n", rails[i], charge((SIM_RAIL_t)i),
+            total ? 100 * charge((SIM_RAIL_t)i) / total : 0);
+  }
+  fprintf(out, "%-12s %14.3f\n\n", "Total", total);
+
+  fprintf(out, "%-12s %14s %8s\n", "CPU state", "Time (s)", "Share");
+  for (int i = 0; i < SIM_CPU_STATES; ++i) {
+    fprintf(out, "%-12s %14.1f %7.2f%%\n", states[i], us[i] / 1e6,
+            elapsed ? 100.0 * us[i] / elapsed : 0);
+  }
+  fprintf(out, "\nAverage current: %.4f mA\n", averageCurrent());
+}
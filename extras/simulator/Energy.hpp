@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#ifndef SIM_ENERGY_H
+#define SIM_ENERGY_H
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Current draw (in mA) of the uNode in each power state. The defaults come
+ * from the ESP8266, SX1276 and MCP23S08 datasheets; measure your own board
+ * and override them for accurate projections.
+ */
+struct SimPowerProfile {
+  float     cpu80;          // CPU running at 80 MHz, WiFi in forced modem sleep
+  float     cpu160;         // CPU running at 160 MHz, WiFi in forced modem sleep
+  float     lightSleep;     // CPU in forced light sleep
+  float     deepSleep;      // Deep sleep
+  float     boot;           // Booting from deep sleep, with RF calibration
+  uint32_t  bootTime;       // How long booting takes (in us)
+  float     wifi;           // Added by WiFi in station mode
+  float     vbus;           // Added by the VBus switch, when VBus is on
+  float     gpio;           // Added by the GPIO expander, powered by VBus
+  float     loraSleep;      // Added by the radio (on VBus), per operating mode
+  float     loraStandby;
+  float     loraRx;
+  float     loraTx;
+};
+
+/**
+ * The state of the CPU
+ */
+typedef enum {
+  SIM_CPU_ACTIVE = 0,
+  SIM_CPU_LIGHT_SLEEP,
+  SIM_CPU_DEEP_SLEEP,
+  SIM_CPU_BOOT,
+  SIM_CPU_STATES
+} SIM_CPU_STATE_t;
+
+/**
+ * The consumers the charge is accounted to, one for every `PowerClass` state
+ */
+typedef enum {
+  SIM_RAIL_CPU = 0,
+  SIM_RAIL_WIFI,
+  SIM_RAIL_VBUS,
+  SIM_RAIL_GPIO,
+  SIM_RAIL_LORA,
+  SIM_RAILS
+} SIM_RAIL_t;
+
+/**
+ * A snapshot of everything that draws current
+ */
+struct SimPowerState {
+  uint8_t   cpu;            // SIM_CPU_STATE_t
+  uint8_t   cpuMHz;         // 80 or 160
+  uint8_t   wifi;           // WiFi in station mode
+  uint8_t   vbus;           // VBus is on (powers the radio and the expander)
+  uint8_t   radio;          // SX1276 operating mode (RegOpMode & 0x07)
+};
+
+/**
+ * Integrates the current drawn in every state over the virtual time
+ */
+class SimEnergy {
+public:
+
+  SimEnergy();
+
+  /**
+   * Clear the accumulated charge, keeping the profile
+   */
+  void reset();
+
+  /**
+   * Account `us` microseconds spent in `state`
+   */
+  void account(const SimPowerState & state, uint64_t us);
+
+  /**
+   * Charge drawn by a rail, or by all of them, in mAh
+   */
+  double charge(SIM_RAIL_t rail) const;
+  double charge() const;
+
+  /**
+   * Time spent in a CPU state, or in total, in microseconds
+   */
+  uint64_t time(SIM_CPU_STATE_t cpu) const;
+  uint64_t time() const;
+
+  /**
+   * The average current so far, in mA
+   */
+  double averageCurrent() const;
+
+  /**
+   * How many days a battery of `capacity` mAh lasts at the average current
+   */
+  double projectDays(double capacity) const;
+
+  /**
+   * Print a breakdown of the charge per rail and of the time per CPU state
+   */
+  void print(FILE * out) const;
+
+  /**
+   * The current draw of the board
+   */
+  SimPowerProfile profile;
+
+private:
+
+  double    mAus[SIM_RAILS];            // Charge in mA * us
+  uint64_t  us[SIM_CPU_STATES];
+
+};
+
+#endif
@@ -0,0 +1,493 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#include <math.h>
+#include <string.h>
+#include "NetworkServer.hpp"
+#include "Crypto.hpp"
+
+#define MTYPE_JOIN_REQUEST      0x00
+#define MTYPE_JOIN_ACCEPT       0x01
+#define MTYPE_UNCONFIRMED_UP    0x02
+#define MTYPE_UNCONFIRMED_DOWN  0x03
+#define MTYPE_CONFIRMED_UP      0x04
+
+#define FCTRL_ADR               0x80
+#define FCTRL_ADRACKREQ         0x40
+#define FCTRL_ACK               0x20
+#define FCTRL_FOPTSLEN          0x0F
+
+#define MAC_LINK_CHECK          0x02
+#define MAC_LINK_ADR            0x03
+
+#define JOIN_ACCEPT_DELAY_us    5000000
+#define RECEIVE_DELAY_us        1000000
+#define RX2_FREQ                869525000
+
+/**
+ * The TXPower indices of LinkADRReq LMIC accepts: 14 dBm down to 2 dBm
+ */
+#define TXPOWER_MAX             1
+#define TXPOWER_MIN             5
+
+/**
+ * Demodulation floor (in dB) of a spreading factor, at 125 kHz
+ */
+static float requiredSnr(uint8_t sf) {
+  return -7.5 - 2.5 * (sf - 7);
+}
+
+/**
+ * The EU868 data rate of a packet
+ */
+static uint8_t dataRateOf(const SimPacket & packet) {
+  if (packet.bw == 250) return 6;
+  return 12 - packet.sf;
+}
+
+static uint32_t rlsbf4(const uint8_t * buf) {
+  return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void wlsbf(std::vector<uint8_t> & frame, uint32_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; ++i) {
+    frame.push_back(value >> (8 * i));
+  }
+}
+
+SimNetworkServer::SimNetworkServer(SX1276Sim & radio)
+  : snr(5), rssi(-90), downlinkSnr(8), downlinkRssi(-60), rx2(0), rx2DataRate(3),
+    adr(1), adrHistory(20), adrMargin(10), netId(0x000013), radio(radio), otaa(0),
+    session(0), devAddr(0), appNonce(0x5A3C01), fcntUp(0), fcntDown(0), uplinked(0),
+    lastDataRate(0), txPower(TXPOWER_MAX), adrPending(0), adrRequested(0xFF),
+    adrPower(TXPOWER_MAX)
+{
+  memset(&stats, 0, sizeof(stats));
+  radio.onTransmit = [this](const SimPacket & uplink) { receive(uplink); };
+}
+
+/**
+ * Register an OTAA device; it has no session until it joins
+ */
+void SimNetworkServer::provision(const uint8_t appEui[8], const uint8_t devEui[8], const uint8_t appKey[16]) {
+  memcpy(this->appEui, appEui, 8);
+  memcpy(this->devEui, devEui, 8);
+  memcpy(this->appKey, appKey, 16);
+  otaa = 1;
+  session = 0;
+}
+
+/**
+ * Register an ABP device, with its session
+ */
+void SimNetworkServer::provision(uint32_t devAddr, const uint8_t nwkSKey[16], const uint8_t appSKey[16]) {
+  memcpy(this->nwkSKey, nwkSKey, 16);
+  memcpy(this->appSKey, appSKey, 16);
+  this->devAddr = devAddr;
+  otaa = 0;
+  session = 1;
+  fcntUp = fcntDown = 0;
+  uplinked = 0;
+}
+
+/**
+ * Demodulate an uplink at the gateway and dispatch it
+ */
+void SimNetworkServer::receive(const SimPacket & uplink) {
+  if (snr < requiredSnr(uplink.sf)) {
+    stats.lost++;
+    return;
+  }
+  if (uplink.data.empty()) {
+    stats.rejected++;
+    return;
+  }
+
+  switch (uplink.data[0] >> 5) {
+    case MTYPE_JOIN_REQUEST:
+      join(uplink);
+      break;
+    case MTYPE_UNCONFIRMED_UP:
+    case MTYPE_CONFIRMED_UP:
+      data(uplink);
+      break;
+    default:
+      stats.rejected++;
+      break;
+  }
+}
+
+uint8_t SimNetworkServer::dataRate() const {
+  return lastDataRate;
+}
+
+uint8_t SimNetworkServer::adrDataRate() const {
+  return adrRequested;
+}
+
+/**
+ * Check a join-request and answer with a join-accept, starting a new session
+ */
+void SimNetworkServer::join(const SimPacket & uplink) {
+  const uint8_t * d = uplink.data.data();
+  uint8_t full[16];
+
+  if (!otaa || (uplink.data.size() != 23) || memcmp(d + 1, appEui, 8) || memcmp(d + 9, devEui, 8)) {
+    stats.rejected++;
+    return;
+  }
+  SimAES aes(appKey);
+  aes.cmac(d, 19, full);
+  if (memcmp(full, d + 19, 4)) {
+    stats.rejected++;
+    return;
+  }
+
+  // A DevNonce can only be used once, or the join-request is a replay
+  uint16_t devNonce = d[17] | (d[18] << 8);
+  for (size_t i = 0; i < devNonces.size(); ++i) {
+    if (devNonces[i] == devNonce) {
+      stats.rejected++;
+      return;
+    }
+  }
+  devNonces.push_back(devNonce);
+  stats.joinRequests++;
+
+  // Join-accept: AppNonce, NetID, DevAddr, DLSettings, RxDelay and the CFList
+  // with the 867.1 ~ 867.9 MHz channels
+  const uint32_t cflist[] = { 867100000, 867300000, 867500000, 867700000, 867900000 };
+  appNonce = (appNonce + 1) & 0xFFFFFF;
+  devAddr = 0x26010000 | (appNonce & 0xFFFF);
+  std::vector<uint8_t> frame;
+  frame.push_back(MTYPE_JOIN_ACCEPT << 5);
+  wlsbf(frame, appNonce, 3);
+  wlsbf(frame, netId, 3);
+  wlsbf(frame, devAddr, 4);
+  frame.push_back(rx2DataRate & 0x0F);
+  frame.push_back(RECEIVE_DELAY_us / 1000000);
+  for (uint8_t i = 0; i < 5; ++i) {
+    wlsbf(frame, cflist[i] / 100, 3);
+  }
+  frame.push_back(0);
+  aes.cmac(frame.data(), frame.size(), full);
+  frame.insert(frame.end(), full, full + 4);
+
+  // The node encrypts the join-accept to read it, so the server decrypts it
+  aes.decrypt(&frame[1]);
+  aes.decrypt(&frame[17]);
+
+  // Session keys: AES(AppKey, 0x01 | AppNonce | NetID | DevNonce | pad)
+  uint8_t block[16] = { 0 };
+  block[1] = appNonce;
+  block[2] = appNonce >> 8;
+  block[3] = appNonce >> 16;
+  block[4] = netId;
+  block[5] = netId >> 8;
+  block[6] = netId >> 16;
+  block[7] = devNonce;
+  block[8] = devNonce >> 8;
+  block[0] = 0x01;
+  memcpy(nwkSKey, block, 16);
+  aes.encrypt(nwkSKey);
+  block[0] = 0x02;
+  memcpy(appSKey, block, 16);
+  aes.encrypt(appSKey);
+
+  session = 1;
+  fcntUp = fcntDown = 0;
+  uplinked = 0;
+  txPower = TXPOWER_MAX;
+  adrPending = 0;
+  adrRequested = 0xFF;
+  snrHistory.clear();
+  commands.clear();
+
+  stats.joinAccepts++;
+  send(uplink, frame, JOIN_ACCEPT_DELAY_us, 1);
+  stats.joinedAt = uplink.end + JOIN_ACCEPT_DELAY_us + (rx2 ? 1000000 : 0);
+}
+
+/**
+ * Check a data uplink, decrypt its payload, run its MAC commands and ADR, and
+ * answer it if needed
+ */
+void SimNetworkServer::data(const SimPacket & uplink) {
+  const uint8_t * d = uplink.data.data();
+  uint8_t len = uplink.data.size();
+  uint8_t m[4];
+
+  if (!session || (len < 12) || (rlsbf4(d + 1) != devAddr)) {
+    stats.rejected++;
+    return;
+  }
+  uint8_t fctrl = d[5];
+  uint8_t olen = fctrl & FCTRL_FOPTSLEN;
+  if (8 + olen + 4 > len) {
+    stats.rejected++;
+    return;
+  }
+
+  // Only the 16 lower bits of the counter are sent: a smaller value than the
+  // last one means it rolled over (and a replay fails the MIC check)
+  uint32_t fcnt = (fcntUp & 0xFFFF0000) | d[6] | (d[7] << 8);
+  if (uplinked && (fcnt < fcntUp)) fcnt += 0x10000;
+  mic(nwkSKey, 0, fcnt, d, len - 4, m);
+  if (memcmp(m, d + len - 4, 4)) {
+    stats.rejected++;
+    return;
+  }
+
+  uint8_t confirmed = (d[0] >> 5) == MTYPE_CONFIRMED_UP;
+  lastDataRate = dataRateOf(uplink);
+  if (uplinked && (fcnt == fcntUp)) {
+    // A retransmission, still waiting for its ACK
+    stats.repeated++;
+    if (confirmed) answer(uplink, 1);
+    return;
+  }
+  uplinked = 1;
+  fcntUp = fcnt;
+  stats.uplinks++;
+  if (confirmed) stats.confirmed++;
+
+  // MAC commands come in FOpts, or in the payload on port 0
+  float margin = snr - requiredSnr(uplink.sf);
+  uint8_t snrMargin = (margin < 0) ? 0 : (margin > 254) ? 254 : (uint8_t)margin;
+  command(d + 8, olen, snrMargin);
+  if (8 + olen < len - 4) {
+    uint8_t port = d[8 + olen];
+    std::vector<uint8_t> payload(d + 9 + olen, d + len - 4);
+    cipher(port ? appSKey : nwkSKey, 0, fcnt, payload.data(), payload.size());
+    if (port == 0) {
+      command(payload.data(), payload.size(), snrMargin);
+    } else if (onData) {
+      onData(port, payload.data(), payload.size());
+    }
+  }
+
+  if (adr && (fctrl & FCTRL_ADR)) {
+    snrHistory.push_back(snr);
+    while (snrHistory.size() > adrHistory) snrHistory.pop_front();
+    runAdr();
+  }
+
+  if (confirmed || !commands.empty() || (fctrl & FCTRL_ADRACKREQ)) {
+    answer(uplink, confirmed);
+  }
+}
+
+/**
+ * Handle the MAC commands of an uplink, queueing the answers
+ */
+void SimNetworkServer::command(const uint8_t * cmd, uint8_t len, uint8_t snrMargin) {
+  uint8_t i = 0;
+  while (i < len) {
+    switch (cmd[i]) {
+      case MAC_LINK_CHECK:
+        commands.push_back(MAC_LINK_CHECK);
+        commands.push_back(snrMargin);
+        commands.push_back(1);
+        stats.linkChecks++;
+        i += 1;
+        break;
+      case MAC_LINK_ADR:
+        if ((i + 1 < len) && ((cmd[i + 1] & 0x07) == 0x07)) {
+          stats.adrAccepted++;
+          txPower = adrPower;
+        } else {
+          adrRequested = 0xFF;
+        }
+        adrPending = 0;
+        i += 2;
+        break;
+      case 0x04:  // DutyCycleAns
+      case 0x08:  // RXTimingSetupAns
+        i += 1;
+        break;
+      case 0x05:  // RXParamSetupAns
+      case 0x07:  // NewChannelAns
+        i += 2;
+        break;
+      case 0x06:  // DevStatusAns
+        i += 3;
+        break;
+      default:
+        // The length of an unknown command is not known, so stop here
+        return;
+    }
+  }
+}
+
+/**
+ * Pick the fastest data rate, then the lowest power, that keeps `adrMargin`
+ * over the demodulation floor, with the best SNR of the history
+ */
+void SimNetworkServer::runAdr() {
+  if (adrPending || (snrHistory.size() < adrHistory) || (lastDataRate > 5)) return;
+
+  float best = snrHistory[0];
+  for (size_t i = 1; i < snrHistory.size(); ++i) {
+    if (snrHistory[i] > best) best = snrHistory[i];
+  }
+
+  // Every 3 dB of margin is one step of data rate or of power
+  int steps = (int)floor((best - requiredSnr(12 - lastDataRate) - adrMargin) / 3);
+  uint8_t dr = lastDataRate;
+  uint8_t power = txPower;
+  while ((steps > 0) && (dr < 5)) {
+    dr++;
+    steps--;
+  }
+  while ((steps > 0) && (power < TXPOWER_MIN)) {
+    power++;
+    steps--;
+  }
+  while ((steps < 0) && (power > TXPOWER_MAX)) {
+    power--;
+    steps++;
+  }
+  if ((dr == lastDataRate) && (power == txPower)) return;
+
+  // DataRate_TXPower, ChMask (channels 0 ~ 7), Redundancy (default NbTrans)
+  commands.push_back(MAC_LINK_ADR);
+  commands.push_back((dr << 4) | power);
+  commands.push_back(0xFF);
+  commands.push_back(0x00);
+  commands.push_back(0x00);
+  adrPending = 1;
+  adrRequested = dr;
+  adrPower = power;
+  snrHistory.clear();
+  stats.adrRequests++;
+}
+
+/**
+ * Send a downlink with the queued MAC commands, and the ACK bit if needed
+ */
+void SimNetworkServer::answer(const SimPacket & uplink, uint8_t ack) {
+  std::vector<uint8_t> frame;
+  uint8_t olen = (commands.size() > 15) ? 0 : commands.size();
+  uint8_t m[4];
+
+  frame.push_back(MTYPE_UNCONFIRMED_DOWN << 5);
+  wlsbf(frame, devAddr, 4);
+  frame.push_back((adr ? FCTRL_ADR : 0) | (ack ? FCTRL_ACK : 0) | olen);
+  wlsbf(frame, fcntDown, 2);
+  frame.insert(frame.end(), commands.begin(), commands.begin() + olen);
+  if (!olen && !commands.empty()) {
+    // Too long for FOpts, send them encrypted on port 0
+    std::vector<uint8_t> payload(commands);
+    cipher(nwkSKey, 1, fcntDown, payload.data(), payload.size());
+    frame.push_back(0);
+    frame.insert(frame.end(), payload.begin(), payload.end());
+  }
+  commands.clear();
+
+  mic(nwkSKey, 1, fcntDown, frame.data(), frame.size(), m);
+  frame.insert(frame.end(), m, m + 4);
+  fcntDown++;
+
+  if (ack) stats.acks++;
+  send(uplink, frame, RECEIVE_DELAY_us, 0);
+}
+
+/**
+ * Put a downlink on the air, in RX1 (same channel and data rate as the
+ * uplink) or in RX2
+ */
+void SimNetworkServer::send(const SimPacket & uplink, std::vector<uint8_t> & frame, uint64_t delay, uint8_t joinAccept) {
+  SimPacket packet;
+  if (rx2) {
+    // Until the join-accept sets it, RX2 is on SF12
+    packet.freq = RX2_FREQ;
+    packet.sf = 12 - (joinAccept ? 0 : rx2DataRate);
+    packet.bw = 125;
+    delay += 1000000;
+  } else {
+    packet.freq = uplink.freq;
+    packet.sf = uplink.sf;
+    packet.bw = uplink.bw;
+  }
+  packet.cr = 5;
+  packet.crc = 0;
+  packet.snr = downlinkSnr;
+  packet.rssi = downlinkRssi;
+  packet.data = frame;
+  packet.start = uplink.end + delay;
+  packet.end = packet.start + SX1276Sim::airtime(packet);
+
+  radio.scheduleDownlink(packet);
+  stats.downlinks++;
+}
+
+/**
+ * The MIC of a data frame: the CMAC of the B0 block and the frame
+ */
+void SimNetworkServer::mic(const uint8_t key[16], uint8_t dir, uint32_t fcnt, const uint8_t * frame, uint8_t len, uint8_t out[4]) const {
+  std::vector<uint8_t> msg(16, 0);
+  uint8_t full[16];
+
+  msg[0] = 0x49;
+  msg[5] = dir;
+  for (uint8_t i = 0; i < 4; ++i) {
+    msg[6 + i] = devAddr >> (8 * i);
+    msg[10 + i] = fcnt >> (8 * i);
+  }
+  msg[15] = len;
+  msg.insert(msg.end(), frame, frame + len);
+
+  SimAES(key).cmac(msg.data(), msg.size(), full);
+  memcpy(out, full, 4);
+}
+
+/**
+ * Encrypt or decrypt the payload of a data frame, XORing it with the
+ * encrypted A blocks
+ */
+void SimNetworkServer::cipher(const uint8_t key[16], uint8_t dir, uint32_t fcnt, uint8_t * data, uint8_t len) const {
+  SimAES aes(key);
+  for (uint8_t b = 0; b * 16 < len; ++b) {
+    uint8_t a[16] = { 0x01, 0, 0, 0, 0, dir };
+    for (uint8_t i = 0; i < 4; ++i) {
+      a[6 + i] = devAddr >> (8 * i);
+      a[10 + i] = fcnt >> (8 * i);
+    }
+    a[15] = b + 1;
+    aes.encrypt(a);
+    for (uint8_t i = 0; (i < 16) && (b * 16 + i < len); ++i) {
+      data[b * 16 + i] ^= a[i];
+    }
+  }
+}
+
+void SimNetworkServer::print(FILE * out) const {
+  fprintf(out, "Network server (SNR %+.1f dB at the gateway):\n", snr);
+  fprintf(out, "  Joins:     %u request(s), %u accepted\n", stats.joinRequests, stats.joinAccepts);
+  fprintf(out, "  Uplinks:   %u (%u confirmed), %u repeated, %u lost, %u rejected\n",
+          stats.uplinks, stats.confirmed, stats.repeated, stats.lost, stats.rejected);
+  fprintf(out, "  Downlinks: %u (%u ACKs)\n", stats.downlinks, stats.acks);
+  fprintf(out, "  MAC:       %u LinkADRReq (%u accepted), %u LinkCheckAns\n",
+          stats.adrRequests, stats.adrAccepted, stats.linkChecks);
+}
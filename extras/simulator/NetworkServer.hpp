@@ -0,0 +1,155 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#ifndef SIM_NETWORK_SERVER_H
+#define SIM_NETWORK_SERVER_H
+#include <stdint.h>
+#include <stdio.h>
+#include <deque>
+#include <functional>
+#include <vector>
+#include "SX1276.hpp"
+
+/**
+ * Counters of a network server run
+ */
+struct SimNetworkStats {
+  uint32_t  joinRequests;
+  uint32_t  joinAccepts;
+  uint32_t  uplinks;            // Valid data uplinks, without repetitions
+  uint32_t  repeated;           // Repetitions of an uplink already received
+  uint32_t  confirmed;          // Confirmed uplinks, without repetitions
+  uint32_t  lost;               // Below the demodulation floor of the gateway
+  uint32_t  rejected;           // Bad MIC, unknown device or replayed counter
+  uint32_t  downlinks;
+  uint32_t  acks;               // Downlinks acknowledging a confirmed uplink
+  uint32_t  adrRequests;        // LinkADRReq commands sent
+  uint32_t  adrAccepted;        // LinkADRAns commands accepting everything
+  uint32_t  linkChecks;         // LinkCheckReq commands answered
+  uint64_t  joinedAt;           // When the last join-accept was sent
+};
+
+/**
+ * A LoRaWAN 1.0 network server and gateway for a single device (EU868)
+ *
+ * It listens to the uplinks of the simulated radio and answers them in RX1
+ * (or RX2), like TTN would, so that OTAA joins, confirmed uplinks and ADR
+ * can be run end to end without a gateway:
+ *  - Join-requests are checked (MIC, DevNonce reuse) and answered with an
+ *    encrypted join-accept carrying the session, the RX2 data rate and the
+ *    5 extra EU868 channels in the CFList
+ *  - Data uplinks are checked (MIC, frame counter replay), their payload is
+ *    decrypted and handed to `onData`
+ *  - Confirmed uplinks are acknowledged, LinkCheckReq is answered and
+ *    ADRACKReq gets a downlink
+ *  - ADR collects the SNR of the last `adrHistory` uplinks and sends a
+ *    LinkADRReq with the fastest data rate (then the lowest power) that
+ *    leaves `adrMargin` dB of margin, like the Semtech reference algorithm
+ *
+ * Every uplink is heard with `snr` dB of SNR, and is lost if that's below
+ * the demodulation floor of its spreading factor.
+ */
+class SimNetworkServer {
+public:
+
+  SimNetworkServer(SX1276Sim & radio);
+
+  /**
+   * Register the device, for OTAA (EUIs in little-endian, like LMIC and the
+   * uNode configuration use them) or with an ABP session
+   */
+  void provision(const uint8_t appEui[8], const uint8_t devEui[8], const uint8_t appKey[16]);
+  void provision(uint32_t devAddr, const uint8_t nwkSKey[16], const uint8_t appSKey[16]);
+
+  /**
+   * Handle an uplink; installed as `radio.onTransmit`
+   */
+  void receive(const SimPacket & uplink);
+
+  /**
+   * The data rate (0 = SF12 ~ 5 = SF7) of the last uplink, and the one ADR
+   * asked for (or 0xFF)
+   */
+  uint8_t dataRate() const;
+  uint8_t adrDataRate() const;
+
+  /**
+   * Print the counters
+   */
+  void print(FILE * out) const;
+
+  /**
+   * Called with the decrypted payload of every new data uplink
+   */
+  std::function<void(uint8_t port, const uint8_t * data, uint8_t len)> onData;
+
+  float     snr;                // SNR of the uplinks at the gateway (dB)
+  int16_t   rssi;               // RSSI of the uplinks at the gateway (dBm)
+  int8_t    downlinkSnr;        // SNR and RSSI of the downlinks at the node
+  int16_t   downlinkRssi;
+  uint8_t   rx2;                // Answer in RX2 instead of RX1
+  uint8_t   rx2DataRate;        // Announced in the join-accept (TTN uses SF9)
+  uint8_t   adr;                // Run ADR for devices that ask for it
+  uint8_t   adrHistory;         // Uplinks to collect before adjusting
+  float     adrMargin;          // Installation margin (dB)
+  uint32_t  netId;
+
+  SimNetworkStats stats;
+
+private:
+
+  void join(const SimPacket & uplink);
+  void data(const SimPacket & uplink);
+  void command(const uint8_t * cmd, uint8_t len, uint8_t snrMargin);
+  void runAdr();
+  void answer(const SimPacket & uplink, uint8_t ack);
+  void send(const SimPacket & uplink, std::vector<uint8_t> & frame, uint64_t delay, uint8_t joinAccept);
+  void mic(const uint8_t key[16], uint8_t dir, uint32_t fcnt, const uint8_t * frame, uint8_t len, uint8_t out[4]) const;
+  void cipher(const uint8_t key[16], uint8_t dir, uint32_t fcnt, uint8_t * data, uint8_t len) const;
+
+  SX1276Sim &           radio;
+  uint8_t               appEui[8];
+  uint8_t               devEui[8];
+  uint8_t               appKey[16];
+  uint8_t               nwkSKey[16];
+  uint8_t               appSKey[16];
+  uint8_t               otaa;
+  uint8_t               session;
+  uint32_t              devAddr;
+  uint32_t              appNonce;
+  uint32_t              fcntUp;
+  uint32_t              fcntDown;
+  uint8_t               uplinked;
+  uint8_t               lastDataRate;
+  uint8_t               txPower;            // LinkADRReq TXPower index
+  uint8_t               adrPending;         // LinkADRReq not answered yet
+  uint8_t               adrRequested;
+  uint8_t               adrPower;
+  std::vector<uint16_t> devNonces;
+  std::deque<float>     snrHistory;
+  std::vector<uint8_t>  commands;           // MAC commands for the next downlink
+
+};
+
+#endif
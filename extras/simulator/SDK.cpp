@@ -0,0 +1,121 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#include "Simulator.hpp"
+
+extern "C" {
+  #include <user_interface.h>
+}
+
+/**
+ * ESP8266 SDK functions on top of the simulator
+ *
+ * Only the forced sleep modes are implemented: forced modem sleep turns the
+ * WiFi off, forced light sleep suspends the CPU on the virtual clock until
+ * the timer expires or a DIO line goes high.
+ */
+
+/**
+ * The RTC clock runs at ~160 kHz, its calibration is the period in 1/4096th
+ * of microseconds
+ */
+#define RTC_PERIOD_CALIBRATION  25600
+
+/**
+ * The reset information Arduino passes to the sketch, updated by
+ * `Sim.deepSleep()`
+ */
+extern "C" struct rst_info resetInfo;
+struct rst_info resetInfo;
+
+static enum sleep_type fpmSleepType = NONE_SLEEP_T;
+static fpm_wakeup_cb fpmWakeupCb = NULL;
+
+uint8 system_update_cpu_freq(uint8 freq) {
+  Sim.power.cpuMHz = freq;
+  return 1;
+}
+
+uint8 system_get_cpu_freq(void) {
+  return Sim.power.cpuMHz;
+}
+
+uint32 system_get_rtc_time(void) {
+  return (uint32)((Sim.now() << 12) / RTC_PERIOD_CALIBRATION);
+}
+
+uint32 system_rtc_clock_cali_proc(void) {
+  return RTC_PERIOD_CALIBRATION;
+}
+
+uint8 wifi_station_disconnect(void) {
+  return 1;
+}
+
+uint8 wifi_set_opmode(uint8 opmode) {
+  Sim.power.wifi = (opmode != NULL_MODE);
+  return 1;
+}
+
+uint8 wifi_get_opmode(void) {
+  return Sim.power.wifi ? STATION_MODE : NULL_MODE;
+}
+
+uint8 wifi_set_sleep_type(enum sleep_type type) {
+  fpmSleepType = type;
+  return 1;
+}
+
+void wifi_fpm_open(void) {
+}
+
+void wifi_fpm_close(void) {
+}
+
+void wifi_fpm_do_wakeup(void) {
+}
+
+int8_t wifi_fpm_do_sleep(uint32 sleep_time_in_us) {
+  if (fpmSleepType == LIGHT_SLEEP_T) {
+    Sim.lightSleep(sleep_time_in_us);
+    if (fpmWakeupCb != NULL) fpmWakeupCb();
+  } else {
+    Sim.power.wifi = 0;
+  }
+  return 0;
+}
+
+void wifi_fpm_set_sleep_type(enum sleep_type type) {
+  fpmSleepType = type;
+}
+
+void wifi_fpm_set_wakeup_cb(fpm_wakeup_cb cb) {
+  fpmWakeupCb = cb;
+}
+
+void wifi_enable_gpio_wakeup(uint32 pin, int level) {
+}
+
+void wifi_disable_gpio_wakeup(void) {
+}
@@ -0,0 +1,384 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "SX1276.hpp"
+
+#include "lmic.h"
+
+#define REG_FIFO                0x00
+#define REG_OPMODE              0x01
+#define REG_FRF_MSB             0x06
+#define REG_FRF_MID             0x07
+#define REG_FRF_LSB             0x08
+#define REG_FIFO_ADDR_PTR       0x0D
+#define REG_FIFO_TX_BASE        0x0E
+#define REG_FIFO_RX_BASE        0x0F
+#define REG_FIFO_RX_CURRENT     0x10
+#define REG_IRQ_FLAGS_MASK      0x11
+#define REG_IRQ_FLAGS           0x12
+#define REG_RX_NB_BYTES         0x13
+#define REG_PKT_SNR             0x19
+#define REG_PKT_RSSI            0x1A
+#define REG_MODEM_CONFIG1       0x1D
+#define REG_MODEM_CONFIG2       0x1E
+#define REG_SYMB_TIMEOUT_LSB    0x1F
+#define REG_PREAMBLE_LSB        0x21
+#define REG_PAYLOAD_LENGTH      0x22
+#define REG_RSSI_WIDEBAND       0x2C
+#define REG_DIO_MAPPING1        0x40
+#define REG_VERSION             0x42
+
+#define MODE_LORA               0x80
+#define MODE_MASK               0x07
+#define MODE_SLEEP              0x00
+#define MODE_STANDBY            0x01
+#define MODE_TX                 0x03
+#define MODE_RX                 0x05
+#define MODE_RX_SINGLE          0x06
+
+#define IRQ_RXTIMEOUT           0x80
+#define IRQ_RXDONE              0x40
+#define IRQ_TXDONE              0x08
+
+/**
+ * The receiver needs to hear this many preamble symbols to lock on a packet
+ */
+#define PREAMBLE_LOCK_SYMBOLS   4
+
+/**
+ * The synthesizer tunes in steps of 61 Hz, so a downlink on the nominal
+ * frequency is heard on the closest step
+ */
+#define SAME_FREQ(a, b)         ((a) + 61 > (b) && (b) + 61 > (a))
+
+SX1276Sim::SX1276Sim(const uint64_t & clock)
+  : now(clock)
+{
+  reset();
+}
+
+/**
+ * Reset the registers to their power-on values
+ */
+void SX1276Sim::reset() {
+  memset(regs, 0, sizeof(regs));
+  memset(fifo, 0, sizeof(fifo));
+  memset(dio, 0, sizeof(dio));
+  regs[REG_OPMODE] = 0x09;
+  regs[REG_FRF_MSB] = 0x6C;
+  regs[REG_FRF_MID] = 0x80;
+  regs[REG_FIFO_RX_BASE] = 0x00;
+  regs[REG_FIFO_TX_BASE] = 0x80;
+  regs[REG_MODEM_CONFIG1] = 0x72;
+  regs[REG_MODEM_CONFIG2] = 0x70;
+  regs[REG_SYMB_TIMEOUT_LSB] = 0x64;
+  regs[REG_PREAMBLE_LSB] = 0x08;
+  regs[REG_PAYLOAD_LENGTH] = 0x01;
+  regs[REG_VERSION] = 0x12;
+  spiFirst = 0;
+  event = EV_NONE;
+  eventAt = UINT64_MAX;
+  edges.clear();
+}
+
+/**
+ * Chip select, a new transaction starts with the register address
+ */
+void SX1276Sim::select(bool selected) {
+  spiFirst = selected;
+}
+
+/**
+ * Single byte SPI transfer. Burst accesses increment the address, except
+ * on the FIFO.
+ */
+uint8_t SX1276Sim::transfer(uint8_t out) {
+  if (spiFirst) {
+    spiFirst = 0;
+    spiAddr = out & 0x7F;
+    spiWrite = (out & 0x80) != 0;
+    return 0;
+  }
+
+  uint8_t value = 0;
+  if (spiWrite) {
+    write(spiAddr, out);
+  } else {
+    value = read(spiAddr);
+  }
+  if (spiAddr != REG_FIFO) {
+    spiAddr = (spiAddr + 1) & 0x7F;
+  }
+  return value;
+}
+
+uint8_t SX1276Sim::read(uint8_t addr) {
+  switch (addr & 0x7F) {
+    case REG_FIFO:
+      return fifo[regs[REG_FIFO_ADDR_PTR]++];
+
+    case REG_RSSI_WIDEBAND:
+      // Noise, used by LMIC to seed its random numbers
+      return rand() & 0xFF;
+
+    default:
+      return regs[addr & 0x7F];
+  }
+}
+
+void SX1276Sim::write(uint8_t addr, uint8_t value) {
+  switch (addr & 0x7F) {
+    case REG_FIFO:
+      fifo[regs[REG_FIFO_ADDR_PTR]++] = value;
+      break;
+
+    case REG_OPMODE:
+      setMode(value);
+      break;
+
+    case REG_IRQ_FLAGS:
+      // Write one to clear
+      regs[REG_IRQ_FLAGS] &= ~value;
+      updateDio();
+      break;
+
+    case REG_VERSION:
+      break;
+
+    default:
+      regs[addr & 0x7F] = value;
+      break;
+  }
+}
+
+/**
+ * The operating mode
+ */
+uint8_t SX1276Sim::mode() const {
+  return regs[REG_OPMODE] & MODE_MASK;
+}
+
+/**
+ * The time of the next event, or UINT64_MAX
+ */
+uint64_t SX1276Sim::nextEvent() const {
+  return (event == EV_NONE) ? UINT64_MAX : eventAt;
+}
+
+/**
+ * Complete the pending event
+ */
+void SX1276Sim::fire() {
+  Event ev = event;
+  event = EV_NONE;
+  eventAt = UINT64_MAX;
+
+  switch (ev) {
+    case EV_TXDONE:
+      current.end = now;
+      transmitted.push_back(current);
+      regs[REG_IRQ_FLAGS] |= IRQ_TXDONE & ~regs[REG_IRQ_FLAGS_MASK];
+      regs[REG_OPMODE] = (regs[REG_OPMODE] & ~MODE_MASK) | MODE_STANDBY;
+      updateDio();
+      if (onTransmit) onTransmit(current);
+      break;
+
+    case EV_RXDONE: {
+      uint8_t base = regs[REG_FIFO_RX_BASE];
+      for (size_t i = 0; i < current.data.size(); ++i) {
+        fifo[(uint8_t)(base + i)] = current.data[i];
+      }
+      regs[REG_FIFO_RX_CURRENT] = base;
+      regs[REG_RX_NB_BYTES] = current.data.size();
+      regs[REG_PKT_SNR] = (uint8_t)(current.snr * 4);
+      regs[REG_PKT_RSSI] = (uint8_t)(current.rssi + 157);
+      regs[REG_IRQ_FLAGS] |= IRQ_RXDONE & ~regs[REG_IRQ_FLAGS_MASK];
+      regs[REG_OPMODE] = (regs[REG_OPMODE] & ~MODE_MASK) | MODE_STANDBY;
+      windows.back().received = 1;
+      updateDio();
+      break;
+    }
+
+    case EV_RXTIMEOUT:
+      regs[REG_IRQ_FLAGS] |= IRQ_RXTIMEOUT & ~regs[REG_IRQ_FLAGS_MASK];
+      regs[REG_OPMODE] = (regs[REG_OPMODE] & ~MODE_MASK) | MODE_STANDBY;
+      updateDio();
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+ * Put a packet on the air, towards the node
+ */
+void SX1276Sim::scheduleDownlink(const SimPacket & packet) {
+  downlinks.push_back(packet);
+}
+
+/**
+ * Handle a write to RegOpMode
+ */
+void SX1276Sim::setMode(uint8_t value) {
+  uint8_t prev = regs[REG_OPMODE] & MODE_MASK;
+  regs[REG_OPMODE] = value;
+  if (!(value & MODE_LORA)) return;
+
+  uint8_t mode = value & MODE_MASK;
+  if (mode == prev) return;
+
+  // Leaving TX or RX aborts the operation
+  event = EV_NONE;
+  eventAt = UINT64_MAX;
+
+  if (mode == MODE_TX) {
+    startTx();
+  } else if (mode == MODE_RX_SINGLE) {
+    startRx();
+  }
+}
+
+/**
+ * Start transmitting the payload in the FIFO
+ */
+void SX1276Sim::startTx() {
+  uint8_t len = regs[REG_PAYLOAD_LENGTH];
+  uint8_t base = regs[REG_FIFO_TX_BASE];
+
+  current = SimPacket();
+  current.start = now;
+  current.freq = frequency();
+  current.sf = spreadingFactor();
+  current.bw = bandwidth();
+  current.cr = 4 + ((regs[REG_MODEM_CONFIG1] >> 1) & 0x07);
+  current.crc = (regs[REG_MODEM_CONFIG2] & 0x04) != 0;
+  for (uint8_t i = 0; i < len; ++i) {
+    current.data.push_back(fifo[(uint8_t)(base + i)]);
+  }
+
+  event = EV_TXDONE;
+  eventAt = now + airtime(current, regs[REG_MODEM_CONFIG1] & 0x01);
+}
+
+/**
+ * The same airtime LMIC uses for its duty-cycle calculations
+ */
+uint64_t SX1276Sim::airtime(const SimPacket & packet, uint8_t implicitHeader) {
+  uint8_t len = packet.data.size();
+  rps_t rps = MAKERPS(packet.sf - 6, (packet.bw == 125) ? BW125 : (packet.bw == 250) ? BW250 : BW500,
+                      packet.cr - 5, implicitHeader ? len : 0, !packet.crc);
+  return osticks2us(calcAirTime(rps, len));
+}
+
+/**
+ * Open a single RX window, and look for a downlink starting in it
+ */
+void SX1276Sim::startRx() {
+  uint64_t tsym = symbolTime();
+  uint16_t symbols = ((regs[REG_MODEM_CONFIG2] & 0x03) << 8) | regs[REG_SYMB_TIMEOUT_LSB];
+
+  SimRxWindow window;
+  window.start = now;
+  window.timeout = now + symbols * tsym;
+  window.freq = frequency();
+  window.sf = spreadingFactor();
+  window.received = 0;
+  windows.push_back(window);
+
+  for (size_t i = 0; i < downlinks.size(); ++i) {
+    const SimPacket & p = downlinks[i];
+    if (!SAME_FREQ(p.freq, window.freq) || (p.sf != window.sf) || (p.bw != bandwidth())) continue;
+
+    // The receiver must be listening before the end of the preamble, and the
+    // preamble must start before the symbol timeout expires
+    uint16_t preamble = (regs[REG_PREAMBLE_LSB] > PREAMBLE_LOCK_SYMBOLS) ? regs[REG_PREAMBLE_LSB] : 8;
+    if ((now <= p.start + (preamble - PREAMBLE_LOCK_SYMBOLS) * tsym) && (p.start <= window.timeout)) {
+      current = p;
+      downlinks.erase(downlinks.begin() + i);
+      event = EV_RXDONE;
+      eventAt = (current.end > now) ? current.end : now;
+      return;
+    }
+  }
+
+  event = EV_RXTIMEOUT;
+  eventAt = window.timeout;
+}
+
+/**
+ * Update the DIO lines from the IRQ flags and the mapping in RegDioMapping1,
+ * queueing rising edges
+ */
+void SX1276Sim::updateDio() {
+  uint8_t map = regs[REG_DIO_MAPPING1];
+  uint8_t flags = regs[REG_IRQ_FLAGS];
+  uint8_t lines[3];
+
+  // LMIC 1.5 ORs MAP_DIO2_LORA_NOP (0xC0) over the DIO0 bits, so DIO0 ends
+  // up with mapping 11 both in TX and in RX. The radio still raises TxDone
+  // and RxDone on it, like with mappings 01 and 00.
+  switch ((map >> 6) & 0x03) {
+    case 0x00: lines[0] = (flags & IRQ_RXDONE) != 0; break;
+    case 0x01: lines[0] = (flags & IRQ_TXDONE) != 0; break;
+    case 0x03: lines[0] = (flags & (IRQ_RXDONE | IRQ_TXDONE)) != 0; break;
+    default:   lines[0] = 0; break;
+  }
+  lines[1] = (((map >> 4) & 0x03) == 0x00) ? (flags & IRQ_RXTIMEOUT) != 0 : 0;
+  lines[2] = 0;
+
+  for (uint8_t i = 0; i < 3; ++i) {
+    if (lines[i] && !dio[i]) {
+      SimEdge edge = { i, now };
+      edges.push_back(edge);
+    }
+    dio[i] = lines[i];
+  }
+}
+
+uint32_t SX1276Sim::frequency() const {
+  uint32_t frf = ((uint32_t)regs[REG_FRF_MSB] << 16) | ((uint32_t)regs[REG_FRF_MID] << 8) | regs[REG_FRF_LSB];
+  return ((uint64_t)frf * 32000000) >> 19;
+}
+
+uint8_t SX1276Sim::spreadingFactor() const {
+  return regs[REG_MODEM_CONFIG2] >> 4;
+}
+
+uint16_t SX1276Sim::bandwidth() const {
+  switch (regs[REG_MODEM_CONFIG1] >> 4) {
+    case 0x08: return 250;
+    case 0x09: return 500;
+    default:   return 125;
+  }
+}
+
+/**
+ * Duration of a symbol in microseconds
+ */
+uint64_t SX1276Sim::symbolTime() const {
+  return ((uint64_t)1000 << spreadingFactor()) / bandwidth();
+}
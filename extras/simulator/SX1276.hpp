@@ -0,0 +1,165 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#ifndef SIM_SX1276_H
+#define SIM_SX1276_H
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/**
+ * A packet on the air, as sent or received by the simulated radio
+ */
+struct SimPacket {
+  uint64_t              start;      // Start of the preamble (virtual us)
+  uint64_t              end;        // End of the transmission (virtual us)
+  uint32_t              freq;       // Frequency in Hz
+  uint8_t               sf;         // Spreading factor (7 ~ 12)
+  uint16_t              bw;         // Bandwidth in kHz (125, 250, 500)
+  uint8_t               cr;         // Coding rate denominator (5 ~ 8)
+  uint8_t               crc;        // Payload CRC enabled
+  int8_t                snr;        // SNR in dB (received packets)
+  int16_t               rssi;       // RSSI in dBm (received packets)
+  std::vector<uint8_t>  data;
+};
+
+/**
+ * A single RX window, as opened by LMIC
+ */
+struct SimRxWindow {
+  uint64_t  start;                  // When the receiver was switched on
+  uint64_t  timeout;                // When it would give up, without a preamble
+  uint32_t  freq;
+  uint8_t   sf;
+  uint8_t   received;               // A packet was received in this window
+};
+
+/**
+ * A rising edge on one of the DIO lines
+ */
+struct SimEdge {
+  uint8_t   dio;
+  uint64_t  time;
+};
+
+/**
+ * Register-level model of the SX1276 in LoRa mode
+ *
+ * It implements the registers, FIFO, operating modes, IRQ flags and DIO
+ * mapping LMIC's `radio.c` uses, and the timing of the packets on the air
+ * (using LMIC's own `calcAirTime`). FSK mode is not modelled.
+ */
+class SX1276Sim {
+public:
+
+  SX1276Sim(const uint64_t & clock);
+
+  /**
+   * Reset the registers to their power-on values
+   */
+  void reset();
+
+  /**
+   * SPI interface: the chip select, and a single byte transfer
+   */
+  void select(bool selected);
+  uint8_t transfer(uint8_t out);
+
+  /**
+   * Direct register access (no side effects on read, except the FIFO)
+   */
+  uint8_t read(uint8_t addr);
+  void write(uint8_t addr, uint8_t value);
+
+  /**
+   * The operating mode (RegOpMode & 0x07)
+   */
+  uint8_t mode() const;
+
+  /**
+   * The time of the next event (TX done, RX done or timeout), or UINT64_MAX
+   */
+  uint64_t nextEvent() const;
+
+  /**
+   * Complete the pending event; the clock must be at `nextEvent()`
+   */
+  void fire();
+
+  /**
+   * Put a packet on the air, towards the node. It's received if an RX window
+   * with the same frequency and spreading factor is open when it starts.
+   */
+  void scheduleDownlink(const SimPacket & packet);
+
+  /**
+   * The time on the air of a packet, in microseconds
+   */
+  static uint64_t airtime(const SimPacket & packet, uint8_t implicitHeader = 0);
+
+  /**
+   * Called when a transmission ends, with the complete packet
+   */
+  std::function<void(const SimPacket &)> onTransmit;
+
+  /**
+   * Pending DIO edges, to be delivered by the HAL
+   */
+  std::deque<SimEdge> edges;
+
+  /**
+   * All the packets sent and the RX windows opened so far
+   */
+  std::vector<SimPacket> transmitted;
+  std::vector<SimRxWindow> windows;
+
+private:
+
+  enum Event { EV_NONE, EV_TXDONE, EV_RXDONE, EV_RXTIMEOUT };
+
+  void setMode(uint8_t value);
+  void startTx();
+  void startRx();
+  void updateDio();
+  uint32_t frequency() const;
+  uint8_t spreadingFactor() const;
+  uint16_t bandwidth() const;
+  uint64_t symbolTime() const;
+
+  const uint64_t &      now;
+  uint8_t               regs[0x80];
+  uint8_t               fifo[256];
+  uint8_t               dio[3];
+  uint8_t               spiAddr;
+  uint8_t               spiWrite;
+  uint8_t               spiFirst;
+  Event                 event;
+  uint64_t              eventAt;
+  SimPacket             current;
+  std::vector<SimPacket> downlinks;
+
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#include <string.h>
+#include "Simulator.hpp"
+
+extern "C" {
+  #include <user_interface.h>
+  extern struct rst_info resetInfo;
+}
+
+SimulatorClass Sim;
+
+SimulatorClass::SimulatorClass()
+  : clock(0), radio(clock), boots(1),
+    vcc(3300), serial(stdout), bootTime(0), runUntil(UINT64_MAX)
+{
+  memset(rtcMemory, 0, sizeof(rtcMemory));
+
+  // The SDK starts with WiFi in station mode, until `Power.begin()`
+  power.cpu = SIM_CPU_ACTIVE;
+  power.cpuMHz = 80;
+  power.wifi = 1;
+  power.vbus = 0;
+  power.radio = 0;
+}
+
+/**
+ * Current virtual time, in microseconds
+ */
+uint64_t SimulatorClass::now() const {
+  return clock;
+}
+
+/**
+ * Virtual time since the last boot
+ */
+uint64_t SimulatorClass::uptime() const {
+  return clock - bootTime;
+}
+
+/**
+ * Move the virtual clock forward, completing the radio events on the way
+ */
+void SimulatorClass::advance(uint64_t us) {
+  uint64_t target = clock + us;
+  while (radio.nextEvent() <= target) {
+    elapse(radio.nextEvent());
+    radio.fire();
+  }
+  elapse(target);
+}
+
+/**
+ * Move the virtual clock forward, until a DIO line goes high
+ */
+uint64_t SimulatorClass::sleep(uint64_t us) {
+  uint64_t start = clock;
+  uint64_t target = clock + us;
+  while (radio.edges.empty() && (radio.nextEvent() <= target)) {
+    elapse(radio.nextEvent());
+    radio.fire();
+  }
+  if (radio.edges.empty()) {
+    elapse(target);
+  }
+  return clock - start;
+}
+
+/**
+ * Same as `sleep`, with the CPU in forced light sleep
+ */
+uint64_t SimulatorClass::lightSleep(uint64_t us) {
+  power.cpu = SIM_CPU_LIGHT_SLEEP;
+  uint64_t slept = sleep(us);
+  power.cpu = SIM_CPU_ACTIVE;
+  return slept;
+}
+
+/**
+ * Deep sleep and boot again
+ */
+void SimulatorClass::deepSleep(uint64_t us, bool rf) {
+  uint64_t target = clock + us;
+
+  // Only the RTC keeps running, and VBus_EN is pulled down
+  setVBus(0);
+  power.cpu = SIM_CPU_DEEP_SLEEP;
+  power.wifi = 0;
+  if (target > runUntil) target = runUntil;
+  if (target > clock) elapse(target);
+
+  // Boot, and start over
+  if (clock < runUntil) {
+    power.cpu = SIM_CPU_BOOT;
+    elapse(clock + energy.profile.bootTime);
+  }
+  bootTime = clock;
+  power.cpu = SIM_CPU_ACTIVE;
+  power.cpuMHz = 80;
+  power.wifi = rf;
+  resetInfo.reason = REASON_DEEP_SLEEP_AWAKE;
+  boots++;
+  throw SimReset();
+}
+
+/**
+ * Switch VBus, the radio starts from its power-on state
+ */
+void SimulatorClass::setVBus(uint8_t enabled) {
+  if (enabled && !power.vbus) {
+    radio.reset();
+  }
+  power.vbus = enabled;
+}
+
+/**
+ * Move the clock to `time`, accounting the energy spent
+ */
+void SimulatorClass::elapse(uint64_t time) {
+  power.radio = radio.mode();
+  energy.account(power, time - clock);
+  clock = time;
+}
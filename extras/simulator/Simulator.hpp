@@ -0,0 +1,179 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+#include <stdint.h>
+#include <stdio.h>
+#include "Energy.hpp"
+#include "SX1276.hpp"
+
+/**
+ * How long (in microseconds) an iteration of the sketch loop is assumed
+ * to take, when nothing else advances the virtual clock
+ */
+#ifndef SIM_LOOP_US
+#define SIM_LOOP_US             100
+#endif
+
+/**
+ * Thrown by `Sim.deepSleep()` to unwind the sketch back to `Sim.run()`
+ */
+struct SimReset { };
+
+/**
+ * The host-side uNode simulator
+ *
+ * Everything runs on a virtual clock that only moves forward when the code
+ * waits (`delay()`, LMIC's `hal_waitUntil`, light or deep sleep) or when the
+ * driver calls `advance()`. The radio events happen at their exact virtual
+ * time, so the MAC timing can be checked to the microsecond, and the time
+ * spent in every power state is accounted by the energy model.
+ */
+class SimulatorClass {
+private:
+
+  // Declared first, the radio keeps a reference to it
+  uint64_t clock;
+
+public:
+
+  SimulatorClass();
+
+  /**
+   * Current virtual time, in microseconds
+   */
+  uint64_t now() const;
+
+  /**
+   * Virtual time since the last boot, what `micros()` counts on the device
+   */
+  uint64_t uptime() const;
+
+  /**
+   * Move the virtual clock forward, completing the radio events on the way
+   */
+  void advance(uint64_t us);
+
+  /**
+   * Same as `advance`, but stop early when a DIO line goes high. Returns the
+   * time actually spent.
+   */
+  uint64_t sleep(uint64_t us);
+
+  /**
+   * Same as `sleep`, with the CPU in forced light sleep
+   */
+  uint64_t lightSleep(uint64_t us);
+
+  /**
+   * Deep sleep for `us` microseconds and boot again: the clock jumps, the
+   * peripherals lose power and the sketch restarts from `setup()`. It only
+   * returns (by throwing `SimReset`) to `run()`.
+   */
+  void deepSleep(uint64_t us, bool rf);
+
+  /**
+   * Run one iteration of the sketch loop: call `step` and let SIM_LOOP_US
+   * pass
+   */
+  template <typename Fn> void loop(Fn step) {
+    step();
+    advance(SIM_LOOP_US);
+  }
+
+  /**
+   * Run a sketch for `us` microseconds of virtual time, calling `setup` on
+   * every boot and `step` in a loop until it enters deep sleep
+   *
+   * The RAM is not cleared when rebooting: global objects keep their state.
+   */
+  template <typename Setup, typename Fn> void run(Setup setup, Fn step, uint64_t us) {
+    runUntil = clock + us;
+    while (clock < runUntil) {
+      try {
+        setup();
+        while (clock < runUntil) {
+          loop(step);
+        }
+      } catch (const SimReset &) {
+      }
+    }
+    runUntil = UINT64_MAX;
+  }
+
+  /**
+   * Switch VBus, which powers the radio and the GPIO expander
+   */
+  void setVBus(uint8_t enabled);
+
+  /**
+   * The simulated radio
+   */
+  SX1276Sim radio;
+
+  /**
+   * The energy model, and the current power state
+   */
+  SimEnergy energy;
+  SimPowerState power;
+
+  /**
+   * The RTC user memory, kept across simulated deep sleeps
+   */
+  uint32_t rtcMemory[128];
+
+  /**
+   * The number of boots
+   */
+  uint32_t boots;
+
+  /**
+   * The supply voltage reported by `ESP.getVcc()`, in mV
+   */
+  uint16_t vcc;
+
+  /**
+   * Where the serial port output goes, NULL to discard it
+   */
+  FILE * serial;
+
+private:
+
+  /**
+   * Move the clock to `time`, accounting the energy spent
+   */
+  void elapse(uint64_t time);
+
+  uint64_t bootTime;
+  uint64_t runUntil;
+
+};
+
+/**
+ * Singleton of the SimulatorClass, available as `Sim`
+ */
+extern SimulatorClass Sim;
+
+#endif
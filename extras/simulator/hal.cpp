@@ -0,0 +1,137 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+
+/**
+ * LMIC hardware abstraction layer on top of the simulator
+ *
+ * Replaces `vendor/LMIC-Arduino/hal/hal.cpp`: the SPI bus and the chip
+ * select go to the simulated SX1276, the DIO edges are delivered with the
+ * virtual time they were raised at, and the timer is the virtual clock.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "Simulator.hpp"
+
+#include "lmic.h"
+#include "hal/hal.h"
+
+// Same as vendor/LMIC-Arduino/hal/hal.cpp
+#define SLEEP_MIN_us    10000
+#define SLEEP_GUARD_us  5000
+#define SLEEP_MAX_us    0xFFFFFFF
+
+/**
+ * LMIC ticks at the virtual time `time`; like `micros()` they start from zero
+ * on every boot
+ */
+static u4_t ticks (uint64_t time) {
+  return (u4_t)((time - Sim.now() + Sim.uptime()) >> US_PER_OSTICK_EXPONENT);
+}
+
+void hal_init () {
+  Sim.radio.reset();
+}
+
+void hal_pin_nss (u1_t val) {
+  Sim.radio.select(val == 0);
+}
+
+void hal_pin_rxtx (u1_t val) {
+}
+
+void hal_pin_rst (u1_t val) {
+  if (val == 0) {
+    Sim.radio.reset();
+  }
+}
+
+u1_t hal_spi (u1_t out) {
+  return Sim.radio.transfer(out);
+}
+
+void hal_spi_write (u1_t* buf, u1_t len) {
+  for (u1_t i = 0; i < len; i++) {
+    Sim.radio.transfer(buf[i]);
+  }
+}
+
+void hal_spi_read (u1_t* buf, u1_t len) {
+  for (u1_t i = 0; i < len; i++) {
+    buf[i] = Sim.radio.transfer(0x00);
+  }
+}
+
+void hal_processPendingIRQs () {
+  while (!Sim.radio.edges.empty()) {
+    SimEdge edge = Sim.radio.edges.front();
+    Sim.radio.edges.pop_front();
+    radio_irq_handler_v2(edge.dio, (ostime_t)ticks(edge.time));
+  }
+}
+
+void hal_disableIRQs () {
+}
+
+void hal_enableIRQs () {
+}
+
+u4_t hal_ticks () {
+  return ticks(Sim.now());
+}
+
+static s4_t delta_time (u4_t time) {
+  return (s4_t)(time - hal_ticks());
+}
+
+void hal_waitUntil (u4_t time) {
+  s4_t delta = delta_time(time);
+  if (delta > 0) {
+    Sim.advance((uint64_t)delta << US_PER_OSTICK_EXPONENT);
+  }
+}
+
+u1_t hal_checkTimer (u4_t time) {
+  return delta_time(time) <= 0;
+}
+
+void hal_sleep (u4_t time) {
+  // Same as on the device: radio events are serviced first, and the CPU only
+  // sleeps (if enabled) when there's enough time, waking up a bit early
+  if (!Sim.radio.edges.empty()) {
+    return;
+  }
+
+  s4_t delta = delta_time(time);
+  if (delta < (SLEEP_MIN_us + SLEEP_GUARD_us) / US_PER_OSTICK) {
+    return;
+  }
+  uint64_t us = ((uint64_t)delta << US_PER_OSTICK_EXPONENT) - SLEEP_GUARD_us;
+  hal_lightSleep((u4_t)(us > SLEEP_MAX_us ? SLEEP_MAX_us : us));
+}
+
+void hal_failed (const char *file, u2_t line) {
+  fprintf(stderr, "LMIC failure at %s:%d\n", file, line);
+  abort();
+}
@@ -0,0 +1,143 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+/**
+ * Minimal ESP8266 Arduino core for the host-side simulator, with the time
+ * functions running on the simulator's virtual clock
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HIGH                0x1
+#define LOW                 0x0
+#define INPUT               0x00
+#define INPUT_PULLUP        0x02
+#define OUTPUT              0x01
+#define RISING              0x01
+#define FALLING             0x02
+#define CHANGE              0x03
+
+#define ICACHE_RAM_ATTR
+#define ADC_MODE(mode)
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+#define digitalPinToInterrupt(pin) (pin)
+#define noInterrupts()
+#define interrupts()
+
+/**
+ * Base classes of the serial port and of SoftWire
+ */
+class Print {
+public:
+  virtual size_t write(uint8_t data) = 0;
+  virtual size_t write(const uint8_t * data, size_t len) {
+    size_t n = 0;
+    while (len--) n += write(*data++);
+    return n;
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+};
+
+/**
+ * The serial port writes to `Sim.serial`, the standard output by default
+ */
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) { }
+  int printf(const char * format, ...) __attribute__((format(printf, 2, 3)));
+  size_t print(const char * str);
+  size_t print(long value);
+  size_t println(const char * str = "");
+  size_t println(long value);
+  size_t write(uint8_t data);
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+  void flush();
+};
+extern HardwareSerial Serial;
+
+/**
+ * The ESP-specific functions the library uses
+ */
+class String {
+public:
+  String(const char * str = "") : value(str) {}
+  void getBytes(unsigned char * buf, unsigned int size) const {
+    size_t len = strlen(value) + 1;
+    memcpy(buf, value, (len < size) ? len : size);
+  }
+private:
+  const char * value;
+};
+
+enum RFMode {
+  WAKE_RF_DEFAULT = 0,
+  WAKE_RF_CAL = 1,
+  WAKE_NO_RFCAL = 2,
+  WAKE_RF_DISABLED = 4
+};
+
+class EspClass {
+public:
+  String getSketchMD5() { return String("00000000000000000000000000000000"); }
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t * data, size_t size);
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t * data, size_t size);
+  uint32_t getCycleCount();
+  uint8_t getCpuFreqMHz();
+  uint16_t getVcc();
+
+  /**
+   * Jumps the virtual clock and reboots the sketch, see `Sim.deepSleep()`
+   */
+  void deepSleep(uint64_t time_us, RFMode mode = WAKE_RF_DEFAULT);
+};
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+
+/**
+ * Battery life projection
+ *
+ * Links against a sketch (any `.ino` compiled as C++), fast-forwards its
+ * duty cycle through `days` of virtual time and prints where the charge
+ * went and how long a battery of `capacity` mAh would last:
+ *
+ *   battery-life [-v] [days] [capacity]
+ *
+ * Deep sleep is a jump of the virtual clock followed by a reboot into
+ * `setup()`. With `-v` the serial output of the sketch is shown.
+ */
+#include <string.h>
+#include <Arduino.h>
+#include "Simulator.hpp"
+
+/**
+ * The sketch
+ */
+void setup();
+void loop();
+
+int main(int argc, char ** argv) {
+  double days = 30;
+  double capacity = 2000;
+  int arg = 1;
+
+  Sim.serial = NULL;
+  if ((arg < argc) && (strcmp(argv[arg], "-v") == 0)) {
+    Sim.serial = stdout;
+    arg++;
+  }
+  if (arg < argc) days = atof(argv[arg++]);
+  if (arg < argc) capacity = atof(argv[arg++]);
+
+  Sim.run(setup, loop, (uint64_t)(days * 86400e6));
+
+  printf("Simulated %.1f days: %u boots, %u uplinks\n\n", Sim.now() / 86400e6,
+         Sim.boots, (unsigned)Sim.radio.transmitted.size());
+  Sim.energy.print(stdout);
+  printf("Projected battery life (%.0f mAh): %.0f days\n", capacity,
+         Sim.energy.projectDays(capacity));
+  return 0;
+}
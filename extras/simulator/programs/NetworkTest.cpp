@@ -0,0 +1,198 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+
+/**
+ * End-to-end LoRaWAN benchmark, against the simulated network server
+ *
+ * Runs a node in OTAA mode through a complete session on the simulated
+ * radio, with `SimNetworkServer` standing in for the gateway and TTN:
+ *  1. Joins, by queueing the first uplink, and measures the time to join
+ *  2. Sends CONFIRMED_UPLINKS confirmed uplinks and counts the ACKs
+ *  3. Falls back to SF12 with ADR enabled, and sends ADR_UPLINKS uplinks
+ *     while the server moves it to the fastest data rate the link allows
+ *
+ *   network-test [snr]
+ *
+ * `snr` is the SNR of the uplinks at the gateway (5 dB by default). It
+ * prints the time to join, the ACK ratio, the ADR convergence and the
+ * uplinks per hour achieved, and exits with a non-zero status if the
+ * session did not work as expected.
+ */
+#include <Arduino.h>
+#include "uNode/util/SystemConfig.hpp"
+#include "uNode/peripherals/LoRa.hpp"
+#include "Simulator.hpp"
+#include "NetworkServer.hpp"
+
+#include "lmic.h"
+
+#define CONFIRMED_UPLINKS   10
+#define ADR_UPLINKS         30
+#define PAYLOAD_SIZE        12
+
+uNodeConfig unode_config = {
+  .lora = {
+    .mode = LORA_TTN_OTAA,
+    .activation = {
+      .otaa = {
+        .appKey = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C },
+        .appEui = { 0x0B, 0x28, 0x01, 0xD0, 0x7E, 0xD5, 0xB3, 0x70 },
+        .devEui = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 }
+      }
+    },
+    .tx_sf = LORA_SF7,
+    .tx_power = 14,
+    .tx_timeout = 60000,
+    .tx_retries = 1,
+    .adr = 1
+  },
+  .logging = LOG_DISABLED
+};
+
+static int failures = 0;
+static int sent = 0;
+static int joined = 0;
+static int received = 0;
+
+#define CHECK(cond, ...) \
+  if (!(cond)) { \
+    printf("FAIL: " __VA_ARGS__); \
+    printf("\n"); \
+    failures++; \
+  }
+
+void packetSent(int status, uint8_t * data, uint8_t len) {
+  sent++;
+}
+
+void networkJoined(int status) {
+  joined = status;
+}
+
+/**
+ * Run the loop until `count` reaches `expected`, for up to `timeout` us
+ */
+static void waitFor(const int & count, int expected, uint64_t timeout) {
+  uint64_t start = Sim.now();
+  while ((count < expected) && (Sim.now() - start < timeout)) {
+    Sim.loop([]() { LoRa.step(); });
+  }
+}
+
+int main(int argc, char ** argv) {
+  uint8_t payload[PAYLOAD_SIZE] = { 0 };
+  SimNetworkServer server(Sim.radio);
+
+  server.provision(unode_config.lora.activation.otaa.appEui, unode_config.lora.activation.otaa.devEui,
+                   unode_config.lora.activation.otaa.appKey);
+  server.onData = [](uint8_t port, const uint8_t * data, uint8_t len) { received++; };
+  if (argc > 1) server.snr = atof(argv[1]);
+
+  system_config_setup();
+  LoRa.begin();
+
+  // 1. Join: queueing the first uplink starts it
+  LoRa.whenJoined(networkJoined);
+  LoRa.whenSent(packetSent);
+  LoRa.sendManaged((const char *)payload, sizeof(payload));
+  waitFor(joined, 1, 3600000000ULL);
+  uint64_t joinTime = Sim.now();
+  waitFor(sent, 1, 120000000ULL);
+  CHECK(joined, "Did not join within an hour");
+  CHECK(sent == 1, "The first uplink was not sent");
+
+  // 2. Confirmed uplinks, straight through LMIC (`LoRaClass` only sends
+  // unconfirmed ones)
+  int acks = 0;
+  uint64_t roundTrip = 0;
+  for (int i = 0; joined && (i < CONFIRMED_UPLINKS); ++i) {
+    delay(LoRa.nextTxTime());
+    uint64_t start = Sim.now();
+    int expected = sent + 1;
+
+    LoRa.whenSent(packetSent);
+    LMIC_setTxData2(2, payload, sizeof(payload), 1);
+    waitFor(sent, expected, 600000000ULL);
+    CHECK(sent == expected, "Confirmed uplink %d was not completed", i);
+    if (LMIC.txrxFlags & TXRX_ACK) acks++;
+    roundTrip += Sim.now() - start;
+  }
+  CHECK(acks == CONFIRMED_UPLINKS, "Only %d of %d confirmed uplinks were ACKed", acks, CONFIRMED_UPLINKS);
+
+  // 3. ADR, starting from SF12
+  size_t first = Sim.radio.transmitted.size();
+  uint64_t adrStart = Sim.now();
+  LMIC_setAdrMode(1);
+  LMIC_setDrTxpow(DR_SF12, 14);
+  for (int i = 0; joined && (i < ADR_UPLINKS); ++i) {
+    delay(LoRa.nextTxTime());
+    int expected = sent + 1;
+
+    LoRa.whenSent(packetSent);
+    LoRa.sendManaged((const char *)payload, sizeof(payload));
+    waitFor(sent, expected, 600000000ULL);
+    CHECK(sent == expected, "ADR uplink %d was not completed", i);
+  }
+
+  // Where the data rate settled, and the uplinks per hour at every data rate
+  // (including the wait for the duty cycle)
+  const std::vector<SimPacket> & tx = Sim.radio.transmitted;
+  size_t settled = first;
+  double interval[13] = { 0 };
+  int count[13] = { 0 };
+  for (size_t i = first; i < tx.size(); ++i) {
+    if (tx[i].sf != tx[settled].sf) settled = i;
+    if (i + 1 < tx.size()) {
+      interval[tx[i].sf] += tx[i + 1].start - tx[i].start;
+      count[tx[i].sf]++;
+    }
+  }
+  CHECK(server.stats.rejected == 0, "The server rejected %u frame(s)", server.stats.rejected);
+  CHECK(server.stats.adrAccepted == server.stats.adrRequests, "The node rejected %u LinkADRReq",
+        server.stats.adrRequests - server.stats.adrAccepted);
+  CHECK((server.adrDataRate() == 0xFF) || (server.dataRate() == server.adrDataRate()),
+        "The node is on DR%d instead of DR%d", server.dataRate(), server.adrDataRate());
+  if (argc == 1) {
+    CHECK(server.dataRate() == 5, "ADR settled on DR%d instead of DR5", server.dataRate());
+  }
+  CHECK(received == (int)server.stats.uplinks, "%d payloads for %u uplinks", received, server.stats.uplinks);
+
+  printf("Time to join: %.1f s (%u join request(s))\n", joinTime / 1e6, server.stats.joinRequests);
+  printf("Confirmed uplinks: %d/%d ACKed (%.0f%%), %llu ms average round trip\n", acks, CONFIRMED_UPLINKS,
+         100.0 * acks / CONFIRMED_UPLINKS, (unsigned long long)(joined ? roundTrip / CONFIRMED_UPLINKS / 1000 : 0));
+  if ((settled < tx.size()) && (settled != first)) {
+    printf("ADR: SF%d to SF%d after %d uplink(s) (%.1f min)\n", tx[first].sf, tx[settled].sf,
+           (int)(settled - first), (tx[settled].start - adrStart) / 60e6);
+  } else if (first < tx.size()) {
+    printf("ADR: stayed on SF%d\n", tx[first].sf);
+  }
+  for (int sf = 12; sf >= 7; --sf) {
+    if (count[sf]) printf("  SF%d: %.1f uplinks/hour\n", sf, count[sf] * 3600e6 / interval[sf]);
+  }
+  printf("Uplinks per hour: %.1f over %.1f h\n\n", server.stats.uplinks * 3600e6 / Sim.now(), Sim.now() / 3600e6);
+  server.print(stdout);
+  printf("%d failure(s)\n", failures);
+  return failures ? 1 : 0;
+}
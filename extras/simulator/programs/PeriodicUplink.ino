@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis - TLab.gr
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+
+/******************************************************************************
+   A typical battery-powered node, for `battery-life`: wake up every
+   UPLINK_INTERVAL seconds, send the supply voltage and deep sleep again.
+
+   The keys only have to be non-zero, the simulator doesn't check them.
+*/
+#include <uNodeOpen.hpp>
+
+ADC_MODE(ADC_VCC);
+
+/**
+ * Seconds between uplinks, and whether to light-sleep between the RX windows
+ */
+#define UPLINK_INTERVAL         600
+#define LIGHT_SLEEP             1
+
+/**
+ * uNode library configuration
+ */
+uNodeConfig unode_config = {
+  .lora = {
+    .mode = LORA_TTN_ABP,
+    .activation = {
+      .abp = {
+        .appKey = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C },
+        .netKey = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C },
+        .devAddr = 0x26011BDA
+      }
+    }
+  }
+};
+
+void packetSent(int status, uint8_t * downstream_data, uint8_t size) {
+  uNode.deepSleep(UPLINK_INTERVAL);
+}
+
+/**
+ * Sketch setup
+ */
+void setup() {
+  uNode.setup();
+  uNode.enableLightSleep(LIGHT_SLEEP);
+
+  uint16_t vcc = ESP.getVcc();
+  uNode.sendLoRa(vcc, packetSent);
+}
+
+/**
+ * Sketch loop
+ */
+void loop() {
+  uNode.step();
+}
@@ -0,0 +1,182 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+
+/**
+ * Uplink path regression test and benchmark
+ *
+ * Sends UPLINKS frames through `LoRaClass` (ABP, SF7, EU868) on the
+ * simulated radio and checks:
+ *  - The frame header (DevAddr and an incrementing FCnt)
+ *  - That every frame is sent on one of the default EU868 channels
+ *  - That LMIC opens RX1 in time to catch a downlink starting exactly one
+ *    second after the uplink, and RX2 on 869.525 MHz / SF9 before the
+ *    receiver can no longer lock on a preamble (4 symbols of 4096 us)
+ *
+ * Then it prints the RX window timing, the latency from `sendManaged` to
+ * the "sent" callback and the throughput the duty-cycle allows.
+ */
+#include <Arduino.h>
+#include "uNode/util/SystemConfig.hpp"
+#include "uNode/peripherals/LoRa.hpp"
+#include "Simulator.hpp"
+
+#include "lmic.h"
+
+#define UPLINKS             10
+#define PAYLOAD_SIZE        20
+
+uNodeConfig unode_config = {
+  .lora = {
+    .mode = LORA_TTN_ABP,
+    .activation = {
+      .abp = {
+        .appKey = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C },
+        .netKey = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C },
+        .devAddr = 0x26011BDA
+      }
+    },
+    .tx_sf = LORA_SF7,
+    .tx_power = 14,
+    .tx_timeout = 10000,
+    .tx_retries = 0
+  },
+  .logging = LOG_DISABLED
+};
+
+static int failures = 0;
+static int sent = 0;
+
+#define CHECK(cond, ...) \
+  if (!(cond)) { \
+    printf("FAIL: " __VA_ARGS__); \
+    printf("\n"); \
+    failures++; \
+  }
+
+/**
+ * The radio synthesizes frequencies in steps of 61 Hz
+ */
+#define SAME_FREQ(a, b)     ((a) + 61 > (b) && (b) + 61 > (a))
+
+void packetSent(int status, uint8_t * data, uint8_t len) {
+  sent++;
+}
+
+/**
+ * Put a (meaningless) downlink on the air, one second after every uplink,
+ * to verify that RX1 catches it
+ */
+void onUplink(const SimPacket & uplink) {
+  SimPacket downlink = uplink;
+  downlink.start = uplink.end + 1000000;
+  downlink.end = downlink.start + (uplink.end - uplink.start);
+  downlink.snr = 8;
+  downlink.rssi = -60;
+  Sim.radio.scheduleDownlink(downlink);
+}
+
+int main() {
+  const uint32_t channels[] = { 868100000, 868300000, 868500000, 867100000,
+                                867300000, 867500000, 867700000, 867900000 };
+  uint8_t payload[PAYLOAD_SIZE] = { 0 };
+  uint64_t latency = 0;
+  uint32_t transactions = 0, bytes = 0;
+
+  system_config_setup();
+  Sim.radio.onTransmit = onUplink;
+  LoRa.begin();
+
+  for (int i = 0; i < UPLINKS; ++i) {
+    // Wait for the duty cycle, then send
+    delay(LoRa.nextTxTime());
+    uint64_t start = Sim.now();
+    int expected = sent + 1;
+    radio_spi_stats_t spi = radio_spiStats;
+
+    LoRa.whenSent(packetSent);
+    LoRa.sendManaged((const char *)payload, sizeof(payload), 1, 10000);
+    while ((sent < expected) && (Sim.now() - start < 60000000)) {
+      Sim.loop([]() { LoRa.step(); });
+    }
+    CHECK(sent == expected, "Uplink %d was not completed", i);
+    latency += Sim.now() - start;
+    transactions += radio_spiStats.transactions - spi.transactions;
+    bytes += radio_spiStats.bytes - spi.bytes;
+  }
+
+  // Verify the uplinks
+  CHECK(Sim.radio.transmitted.size() == UPLINKS, "Expected %d uplinks, got %d",
+        UPLINKS, (int)Sim.radio.transmitted.size());
+  for (size_t i = 0; i < Sim.radio.transmitted.size(); ++i) {
+    const SimPacket & p = Sim.radio.transmitted[i];
+    uint32_t devAddr = p.data[1] | (p.data[2] << 8) | (p.data[3] << 16) | ((uint32_t)p.data[4] << 24);
+    uint16_t fcnt = p.data[6] | (p.data[7] << 8);
+    bool known = false;
+    for (size_t c = 0; c < sizeof(channels) / sizeof(channels[0]); ++c) {
+      known |= SAME_FREQ(p.freq, channels[c]);
+    }
+
+    CHECK(p.data.size() == PAYLOAD_SIZE + 13, "Uplink %d is %d bytes", (int)i, (int)p.data.size());
+    CHECK(devAddr == unode_config.lora.activation.abp.devAddr, "Uplink %d has DevAddr %08x", (int)i, devAddr);
+    CHECK(fcnt == i, "Uplink %d has FCnt %d", (int)i, fcnt);
+    CHECK(known, "Uplink %d on unknown frequency %u", (int)i, p.freq);
+    CHECK(p.sf == 7, "Uplink %d on SF%d", (int)i, p.sf);
+  }
+
+  // Verify the RX windows: RX1 catches the downlink, so there's no RX2
+  int64_t earliest = INT64_MAX, latest = INT64_MIN;
+  CHECK(Sim.radio.windows.size() >= UPLINKS, "Expected %d RX windows, got %d",
+        UPLINKS, (int)Sim.radio.windows.size());
+  for (size_t i = 0, w = 0; (i < Sim.radio.transmitted.size()) && (w < Sim.radio.windows.size()); ++i, ++w) {
+    const SimPacket & p = Sim.radio.transmitted[i];
+    const SimRxWindow & rx1 = Sim.radio.windows[w];
+    int64_t offset = (int64_t)rx1.start - (int64_t)(p.end + 1000000);
+    if (offset < earliest) earliest = offset;
+    if (offset > latest) latest = offset;
+
+    CHECK(rx1.freq == p.freq, "RX1 of uplink %d on %u instead of %u", (int)i, rx1.freq, p.freq);
+    CHECK(rx1.received, "RX1 of uplink %d missed the downlink (opened at %+lld us)", (int)i, (long long)offset);
+
+    // The downlink is not valid, so LMIC also opens RX2
+    if ((w + 1 < Sim.radio.windows.size()) && (Sim.radio.windows[w + 1].start < p.end + 3000000)) {
+      const SimRxWindow & rx2 = Sim.radio.windows[++w];
+      int64_t offset2 = (int64_t)rx2.start - (int64_t)(p.end + 2000000);
+      CHECK(SAME_FREQ(rx2.freq, 869525000), "RX2 of uplink %d on %u", (int)i, rx2.freq);
+      CHECK(rx2.sf == 9, "RX2 of uplink %d on SF%d", (int)i, rx2.sf);
+      CHECK((offset2 > -20000) && (offset2 < 4 * 4096), "RX2 of uplink %d opened at %+lld us", (int)i, (long long)offset2);
+    }
+  }
+
+  printf("Uplinks: %d, airtime: %llu us each\n", UPLINKS,
+         (unsigned long long)(Sim.radio.transmitted[0].end - Sim.radio.transmitted[0].start));
+  printf("RX1 opened between %+lld us and %+lld us from the downlink start\n",
+         (long long)earliest, (long long)latest);
+  printf("Average latency (send to callback): %llu ms\n", (unsigned long long)(latency / UPLINKS / 1000));
+  printf("Radio SPI traffic: %u transactions, %u bytes per uplink\n",
+         transactions / UPLINKS, bytes / UPLINKS);
+  printf("Throughput: %.1f uplinks/hour in %.1f s\n", UPLINKS * 3600.0 / (Sim.now() / 1e6), Sim.now() / 1e6);
+  printf("%d failure(s)\n", failures);
+  return failures ? 1 : 0;
+}
@@ -95,6 +95,12 @@ struct uNodeConfigLora {
    */
   uint8_t             adr;
 
+  /**
+   * Put the CPU in light sleep while LMIC is waiting for its next job (such
+   * as the RX windows). This makes `uNode.step()` block until then.
+   */
+  uint8_t             light_sleep;
+
 };
 
 /**
@@ -41,6 +41,13 @@
 typedef void(*fnLoRaCallback)(int status);
 typedef void(*fnLoRaDataCallback)(int status, uint8_t *data, uint8_t len);
 
+/**
+ * A function called on every `uNode.step()`, for drivers that work in the
+ * background (up to `UNODE_STEP_HANDLERS` of them)
+ */
+typedef void(*fnStepCallback)();
+#define UNODE_STEP_HANDLERS     4
+
 /**
  * Standby mode enum constant
  */
@@ -93,6 +100,20 @@ typedef enum {
   LORA_SF7B
 } LORA_SPREADFACTOR_t;
 
+/**
+ * Priority of a queued LoRa uplink
+ */
+typedef enum {
+  LORA_PRIORITY_LOW     = 0,  // Sent last, dropped first when the queue is full
+  LORA_PRIORITY_NORMAL  = 1,  // Default priority
+  LORA_PRIORITY_HIGH    = 2   // Sent before any other queued frame
+} LORA_PRIORITY_t;
+
+/**
+ * The maximum application payload LMIC can carry in a single frame
+ */
+#define LORA_MAX_PAYLOAD        51
+
 /**
  * Constants for the uNodeUVConfig
  */
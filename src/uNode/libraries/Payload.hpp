@@ -0,0 +1,253 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Compile-time payload schemas
+ *
+ * Sending a structure with `uNode.sendLoRa(data)` transmits it as it's laid out
+ * in memory, including padding and 4-byte floats. A schema instead declares
+ * every field with the number of bits it really needs, and packs them MSB-first
+ * in a bitstream whose size is known at compile time:
+ *
+ *   typedef PayloadSchema<
+ *     PayloadScaled<-40, 85, 10>,   // Temperature, -40 ~ 85 with 0.1 steps
+ *     PayloadScaled<0, 100, 2>,     // Humidity, 0 ~ 100 with 0.5 steps
+ *     PayloadUInt<12>,              // Battery voltage in mV (0 ~ 4095)
+ *     PayloadBool                   // Door open
+ *   > SensorPayload;
+ *
+ *   SensorPayload::Packet packet;   // 4 bytes
+ *   SensorPayload::encode(packet, 21.5, 45.0, ESP.getVcc(), 1);
+ *   uNode.sendLoRa(packet);
+ *
+ * The matching decoder for the network server can be generated with
+ * `SensorPayload::writeDecoder(Serial, names)`. It only needs an object with
+ * `print(const char*)` and `print(long)`, so the same schema header can also be
+ * compiled in a host-side tool.
+ */
+
+/**
+ * Number of bits needed to represent the values 0 ~ range
+ */
+constexpr uint8_t payloadBitsFor(uint32_t range) {
+  return (range == 0) ? 0 : 1 + payloadBitsFor(range >> 1);
+}
+
+/**
+ * Write the `bits` lower bits of `value` at the given bit offset, MSB-first
+ */
+inline void payloadWriteBits(uint8_t * data, uint16_t offset, uint32_t value, uint8_t bits) {
+  for (uint8_t i = bits; i > 0; --i, ++offset) {
+    if (value & (1UL << (i - 1))) {
+      data[offset >> 3] |= 0x80 >> (offset & 7);
+    }
+  }
+}
+
+/**
+ * Read `bits` bits from the given bit offset, MSB-first
+ */
+inline uint32_t payloadReadBits(const uint8_t * data, uint16_t offset, uint8_t bits) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < bits; ++i, ++offset) {
+    value = (value << 1) | ((data[offset >> 3] >> (7 - (offset & 7))) & 1);
+  }
+  return value;
+}
+
+/**
+ * An unsigned integer field of `BITS` bits, larger values are saturated
+ */
+template <uint8_t BITS> struct PayloadUInt {
+  static_assert(BITS > 0 && BITS <= 32, "PayloadUInt supports 1 ~ 32 bits");
+  static const uint8_t bits = BITS;
+
+  static uint32_t pack(uint32_t value) {
+    const uint32_t max = 0xFFFFFFFFUL >> (32 - BITS);
+    return (value > max) ? max : value;
+  }
+
+  template <typename Output> static void writeDecoder(Output & out, uint16_t offset) {
+    out.print("bits(");
+    out.print((long)offset);
+    out.print(", ");
+    out.print((long)bits);
+    out.print(")");
+  }
+};
+
+/**
+ * An integer field in the range MIN ~ MAX, values outside it are saturated
+ */
+template <int32_t MIN, int32_t MAX> struct PayloadInt {
+  static_assert(MAX > MIN, "PayloadInt needs MAX > MIN");
+  static const uint8_t bits = payloadBitsFor((uint32_t)((int64_t)MAX - MIN));
+
+  static uint32_t pack(int32_t value) {
+    if (value < MIN) value = MIN;
+    if (value > MAX) value = MAX;
+    return (uint32_t)((int64_t)value - MIN);
+  }
+
+  template <typename Output> static void writeDecoder(Output & out, uint16_t offset) {
+    PayloadUInt<bits>::writeDecoder(out, offset);
+    out.print(" + ");
+    out.print((long)MIN);
+  }
+};
+
+/**
+ * A real number in the range MIN ~ MAX, with a resolution of 1/SCALE. Values
+ * are rounded to the closest step and saturated to the range.
+ *
+ * NaN (e.g. a failed `DHT::readTemperature()`) is encoded as MIN, so pick a
+ * MIN below the values the sensor can report if failed readings must be told
+ * apart.
+ */
+template <int32_t MIN, int32_t MAX, uint16_t SCALE> struct PayloadScaled {
+  static_assert(MAX > MIN, "PayloadScaled needs MAX > MIN");
+  static_assert(SCALE > 0, "PayloadScaled needs SCALE > 0");
+  static const uint64_t steps = (uint64_t)((int64_t)MAX - MIN) * SCALE;
+  static_assert(steps <= 0xFFFFFFFFULL, "PayloadScaled needs (MAX - MIN) * SCALE to fit in 32 bits");
+  static const uint8_t bits = payloadBitsFor((uint32_t)steps);
+
+  static uint32_t pack(float value) {
+    if (value != value) return 0;     // NaN
+    // In double, as a float can't hold MIN, MAX or every step of a wide range
+    double clamped = value;
+    if (clamped < MIN) clamped = MIN;
+    if (clamped > MAX) clamped = MAX;
+    double scaled = (clamped - MIN) * SCALE + 0.5;
+    if (scaled > steps) return (uint32_t)steps;
+    return (uint32_t)scaled;
+  }
+
+  template <typename Output> static void writeDecoder(Output & out, uint16_t offset) {
+    PayloadUInt<bits>::writeDecoder(out, offset);
+    out.print(" / ");
+    out.print((long)SCALE);
+    out.print(" + ");
+    out.print((long)MIN);
+  }
+};
+
+/**
+ * A single-bit boolean field
+ */
+struct PayloadBool {
+  static const uint8_t bits = 1;
+
+  static uint32_t pack(bool value) {
+    return value ? 1 : 0;
+  }
+
+  template <typename Output> static void writeDecoder(Output & out, uint16_t offset) {
+    PayloadUInt<1>::writeDecoder(out, offset);
+    out.print(" == 1");
+  }
+};
+
+/**
+ * A payload made of the given fields, in this order
+ */
+template <typename... Fields> struct PayloadSchema;
+
+template <> struct PayloadSchema<> {
+  static const uint16_t BITS = 0;
+
+  static void encodeAt(uint8_t *, uint16_t) { }
+
+  template <typename Output>
+  static void writeFields(Output &, const char * const [], uint16_t) { }
+};
+
+template <typename Field, typename... Rest> struct PayloadSchema<Field, Rest...> {
+
+  /**
+   * The size of the payload, in bits and in bytes
+   */
+  static const uint16_t BITS = Field::bits + PayloadSchema<Rest...>::BITS;
+  static const uint16_t SIZE = (BITS + 7) / 8;
+
+  /**
+   * The encoded payload, to be passed to `uNode.sendLoRa`
+   */
+  struct Packet {
+    uint8_t data[SIZE];
+  };
+
+  /**
+   * Encode the given values (one per field) in the packet
+   */
+  template <typename... Values>
+  static void encode(Packet & packet, Values... values) {
+    static_assert(sizeof...(Values) == sizeof...(Rest) + 1, "One value per field is required");
+    memset(packet.data, 0, SIZE);
+    encodeAt(packet.data, 0, values...);
+  }
+
+  template <typename Value, typename... Values>
+  static void encodeAt(uint8_t * data, uint16_t offset, Value value, Values... values) {
+    payloadWriteBits(data, offset, Field::pack(value), Field::bits);
+    PayloadSchema<Rest...>::encodeAt(data, offset + Field::bits, values...);
+  }
+
+  /**
+   * Write a JavaScript payload decoder (The Things Network format) for this
+   * schema, using the given field names (one per field)
+   */
+  template <typename Output>
+  static void writeDecoder(Output & out, const char * const names[]) {
+    out.print("function Decoder(bytes, port) {\n");
+    out.print("  function bits(offset, count) {\n");
+    out.print("    var value = 0;\n");
+    out.print("    for (var i = offset; i < offset + count; ++i) {\n");
+    out.print("      value = value * 2 + ((bytes[i >> 3] >> (7 - (i & 7))) & 1);\n");
+    out.print("    }\n");
+    out.print("    return value;\n");
+    out.print("  }\n");
+    out.print("  return {\n");
+    writeFields(out, names, 0);
+    out.print("  };\n");
+    out.print("}\n");
+  }
+
+  template <typename Output>
+  static void writeFields(Output & out, const char * const names[], uint16_t offset) {
+    out.print("    ");
+    out.print(names[0]);
+    out.print(": ");
+    Field::writeDecoder(out, offset);
+    out.print((sizeof...(Rest) > 0) ? ",\n" : "\n");
+    PayloadSchema<Rest...>::writeFields(out, names + 1, offset + Field::bits);
+  }
+
+};
+
+#endif
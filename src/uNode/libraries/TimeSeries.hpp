@@ -0,0 +1,300 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+#include <stdint.h>
+#include <string.h>
+#include "Payload.hpp"
+
+/**
+ * Time-series compression
+ *
+ * When many readings are collected and sent in a single uplink, consecutive
+ * samples are usually very similar. The encoder packs (timestamp, value)
+ * samples in a bitstream, Gorilla-style:
+ *
+ * - The first byte is the number of samples in the stream
+ * - The first sample is stored as-is (32-bit timestamp, 32-bit float)
+ * - Timestamps are stored as the difference between consecutive deltas:
+ *   `0` when the sampling interval didn't change, or `1` followed by the
+ *   zig-zag encoded difference as a varint (7 bits + continuation per byte)
+ * - Values are XOR-ed with the previous one: `0` when equal, `10` followed by
+ *   the meaningful bits if they fit in the previous leading/trailing zero
+ *   window, or `11`, 5 bits of leading zeros, 5 bits of length - 1 and the
+ *   meaningful bits otherwise
+ *
+ * The encoder fills the given buffer until the next sample doesn't fit:
+ *
+ *   uint8_t buffer[LORA_MAX_PAYLOAD];
+ *   TimeSeriesEncoder encoder(buffer, uNode.maxPayload());
+ *   size_t consumed = encoder.add(timestamps, values, count);
+ *   uNode.sendLoRa((const char *)buffer, encoder.length());
+ *
+ * `TimeSeriesDecoder` reads the stream back.
+ */
+
+/**
+ * Zig-zag encoding of signed integers, so that small negative numbers are
+ * also small unsigned numbers
+ */
+inline uint32_t timeSeriesZigZag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+inline int32_t timeSeriesUnZigZag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ * Streaming time-series encoder
+ */
+class TimeSeriesEncoder {
+public:
+
+  TimeSeriesEncoder(uint8_t * buffer, size_t size)
+    : data(buffer), size(size)
+  {
+    reset();
+  }
+
+  /**
+   * Start a new stream in the same buffer
+   */
+  void reset() {
+    memset(data, 0, size);
+    offset = 8;
+    samples = 0;
+    lastTimestamp = 0;
+    lastDelta = 0;
+    lastValue = 0;
+    leading = 0xFF;
+    trailing = 0;
+  }
+
+  /**
+   * Append a sample, returns `false` if it doesn't fit in the buffer
+   */
+  bool add(uint32_t timestamp, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (samples == 0xFF) return false;
+
+    // Measure first, so a sample that doesn't fit leaves the stream intact
+    uint16_t len = encode(NULL, offset, timestamp, bits);
+    if (offset + len > size * 8) return false;
+    offset += encode(data, offset, timestamp, bits);
+
+    // Update the state
+    if (samples > 0) {
+      lastDelta = (int32_t)(timestamp - lastTimestamp);
+    }
+    if (samples > 0 && (bits ^ lastValue) != 0) {
+      uint32_t x = bits ^ lastValue;
+      uint8_t lz = __builtin_clz(x), tz = __builtin_ctz(x);
+      if ((leading == 0xFF) || (lz < leading) || (tz < trailing)) {
+        leading = lz;
+        trailing = tz;
+      }
+    }
+    lastTimestamp = timestamp;
+    lastValue = bits;
+    data[0] = ++samples;
+    return true;
+  }
+
+  /**
+   * Append up to `count` samples, returns how many of them fit in the buffer
+   */
+  size_t add(const uint32_t * timestamps, const float * values, size_t count) {
+    size_t i;
+    for (i = 0; i < count; ++i) {
+      if (!add(timestamps[i], values[i])) break;
+    }
+    return i;
+  }
+
+  /**
+   * Number of samples in the stream
+   */
+  uint8_t count() const {
+    return samples;
+  }
+
+  /**
+   * Length of the stream in bytes
+   */
+  size_t length() const {
+    return (offset + 7) / 8;
+  }
+
+private:
+
+  /**
+   * Write the given sample at `at` (or only measure it if `out` is NULL) and
+   * return the number of bits it takes
+   */
+  uint16_t encode(uint8_t * out, uint16_t at, uint32_t timestamp, uint32_t bits) const {
+    uint16_t start = at;
+
+    // The first sample is stored as-is
+    if (samples == 0) {
+      put(out, at, timestamp, 32);
+      put(out, at, bits, 32);
+      return at - start;
+    }
+
+    // Delta-of-delta timestamp
+    int32_t dod = (int32_t)(timestamp - lastTimestamp) - lastDelta;
+    if (dod == 0) {
+      put(out, at, 0, 1);
+    } else {
+      uint32_t zz = timeSeriesZigZag(dod);
+      put(out, at, 1, 1);
+      do {
+        uint8_t group = zz & 0x7F;
+        zz >>= 7;
+        put(out, at, zz ? (group | 0x80) : group, 8);
+      } while (zz);
+    }
+
+    // XOR-ed value
+    uint32_t x = bits ^ lastValue;
+    if (x == 0) {
+      put(out, at, 0, 1);
+      return at - start;
+    }
+    uint8_t lz = __builtin_clz(x), tz = __builtin_ctz(x);
+    if ((leading != 0xFF) && (lz >= leading) && (tz >= trailing)) {
+      put(out, at, 2, 2);
+      put(out, at, x >> trailing, 32 - leading - trailing);
+    } else {
+      put(out, at, 3, 2);
+      put(out, at, lz, 5);
+      put(out, at, 32 - lz - tz - 1, 5);
+      put(out, at, x >> tz, 32 - lz - tz);
+    }
+    return at - start;
+  }
+
+  static void put(uint8_t * out, uint16_t & at, uint32_t value, uint8_t bits) {
+    if (out) payloadWriteBits(out, at, value, bits);
+    at += bits;
+  }
+
+  uint8_t *   data;
+  size_t      size;
+  uint16_t    offset;
+  uint8_t     samples;
+  uint32_t    lastTimestamp;
+  int32_t     lastDelta;
+  uint32_t    lastValue;
+  uint8_t     leading;
+  uint8_t     trailing;
+
+};
+
+/**
+ * Time-series decoder, for streams created with `TimeSeriesEncoder`
+ */
+class TimeSeriesDecoder {
+public:
+
+  TimeSeriesDecoder(const uint8_t * buffer, size_t size)
+    : data(buffer), size(size), offset(8), samples(0),
+      lastTimestamp(0), lastDelta(0), lastValue(0), leading(0), trailing(0)
+  { }
+
+  /**
+   * Number of samples in the stream
+   */
+  uint8_t count() const {
+    return (size > 0) ? data[0] : 0;
+  }
+
+  /**
+   * Read the next sample, returns `false` at the end of the stream
+   */
+  bool next(uint32_t & timestamp, float & value) {
+    if (samples >= count()) return false;
+
+    if (samples == 0) {
+      lastTimestamp = get(32);
+      lastValue = get(32);
+    } else {
+      // Delta-of-delta timestamp
+      if (get(1)) {
+        uint32_t zz = 0;
+        uint8_t shift = 0, group;
+        do {
+          group = get(8);
+          zz |= (uint32_t)(group & 0x7F) << shift;
+          shift += 7;
+        } while ((group & 0x80) && (shift < 35));
+        lastDelta += timeSeriesUnZigZag(zz);
+      }
+      lastTimestamp += lastDelta;
+
+      // XOR-ed value
+      if (get(1)) {
+        if (get(1)) {
+          leading = get(5);
+          uint8_t len = get(5) + 1;
+          trailing = 32 - leading - len;
+        }
+        lastValue ^= get(32 - leading - trailing) << trailing;
+      }
+    }
+
+    samples++;
+    timestamp = lastTimestamp;
+    memcpy(&value, &lastValue, sizeof(value));
+    return true;
+  }
+
+private:
+
+  uint32_t get(uint8_t bits) {
+    if (offset + bits > size * 8) {
+      offset = size * 8;
+      return 0;
+    }
+    uint32_t value = payloadReadBits(data, offset, bits);
+    offset += bits;
+    return value;
+  }
+
+  const uint8_t * data;
+  size_t          size;
+  uint16_t        offset;
+  uint8_t         samples;
+  uint32_t        lastTimestamp;
+  int32_t         lastDelta;
+  uint32_t        lastValue;
+  uint8_t         leading;
+  uint8_t         trailing;
+
+};
+
+#endif
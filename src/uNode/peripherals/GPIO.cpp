@@ -28,6 +28,7 @@
 
 #include <Arduino.h>
 #include "GPIO.hpp"
+#include "SPIBus.hpp"
 #include "../Pinout.hpp"
 
 #define pinMask(pin)  (1 << pin)
@@ -35,6 +36,11 @@
 #define MCP23S08_HAEN_SHIFT 3
 #define MCP23S08_SEQOP_SHIFT 5
 
+// Shadow registers changed while batching
+#define DIRTY_GPPU    0x01
+#define DIRTY_OLAT    0x02
+#define DIRTY_IODIR   0x04
+
 
 /**
  * Initialize the singleton
@@ -45,7 +51,8 @@ GPIOClass GPIO;
 /**
  * Constructor
  */
-GPIOClass::GPIOClass() {
+GPIOClass::GPIOClass()
+  : _batching( 0 ), _dirty( 0 ), _watched( 0 ), _intPin( 0xff ), _portState( 0 ), _portChanged( 0 ), _i2cClock( 0 ) {
 }
 
 
@@ -54,23 +61,34 @@ GPIOClass::GPIOClass() {
  */
 void GPIOClass::begin() {
 
-  SPI.begin();                // Setup the SPI.
-
-  ::pinMode( UPIN_GPIO, OUTPUT );
-  ::digitalWrite( UPIN_GPIO, HIGH );      // GPIO Chip Select not selected.
+  // Setup the SPI, with the GPIO Chip Select not selected.
+  SPIBus.setDevice( SPI_DEVICE_GPIO, UPIN_GPIO, 12000000 );
 
-  // Enable hardware address pins and disable auto register address increment.
-  writeRegister( registerIOCON, ( 1 << MCP23S08_HAEN_SHIFT ) | ( 1 << MCP23S08_SEQOP_SHIFT ) );
+  // Enable hardware address pins and auto register address increment. The chip
+  // keeps the increment disabled from an earlier begin() if VBus stayed on.
+  writeRegister( registerIOCON, ( 1 << MCP23S08_HAEN_SHIFT ) );
 
   // make sure shadow registers are in sync with chip (same as PU reset state).
   _inputPullup = 0;             // Inputs in high Z.
-  writeRegister( registerGPPU, _inputPullup );
-
   _direction = 0xff;              // All input
-  writeRegister( registerIODIR, _direction );
-
   _outputState = 0;             // And outputs starting low
-  writeRegister( registerGPIO, _outputState );
+  _dirty = 0;
+
+  // Write all the registers in one sequential burst, starting from GPPU. The
+  // address wraps around after OLAT, and IOCON comes last to disable the auto
+  // increment again (timeHalfPulse() depends on repeated reads of GPIO).
+  const uint8_t registers[] = {
+    _inputPullup,             // GPPU
+    0, 0,                     // INTF, INTCAP (read-only)
+    _outputState,             // GPIO
+    _outputState,             // OLAT
+    _direction,               // IODIR
+    0,                        // IPOL
+    _watched,                 // GPINTEN, kept from an earlier watchPort()
+    0, 0,                     // DEFVAL, INTCON (compare with the previous value)
+    ( 1 << MCP23S08_HAEN_SHIFT ) | ( 1 << MCP23S08_SEQOP_SHIFT )   // IOCON
+  };
+  writeRegisters( registerGPPU, registers, sizeof( registers ) );
 }
 
 
@@ -89,29 +107,35 @@ void GPIOClass::end() {
  */
 void GPIOClass::pinMode( uint8_t pin, uint8_t mode ) {
   if ( pin > 7 ) return;            // Silently ignore non-existing pins.
+  pinModePort( pinMask( pin ), mode );
+}
+
 
+/**
+ * Set the direction of all the pins in the mask
+ */
+void GPIOClass::pinModePort( uint8_t mask, uint8_t mode ) {
   uint8_t direction = _direction;
   uint8_t pullup = _inputPullup;
 
   switch ( mode ) {
     case OUTPUT:
-      _direction &= ~pinMask( pin );
+      _direction &= ~mask;
       break;
 
     case INPUT_PULLUP:
-      _inputPullup |= pinMask( pin );
-      _direction |= pinMask( pin );
+      _inputPullup |= mask;
+      _direction |= mask;
       break;
 
     case INPUT:
     default:                  // Least harmfull one if unknown mode
-      _inputPullup &= ~pinMask( pin );
-      _direction |= pinMask( pin );
+      _inputPullup &= ~mask;
+      _direction |= mask;
       break;
   }
 
-  if ( pullup != _inputPullup ) writeRegister( registerGPPU, _inputPullup );
-  if ( direction != _direction ) writeRegister( registerIODIR, _direction );
+  update( ( pullup != _inputPullup ? DIRTY_GPPU : 0 ) | ( direction != _direction ? DIRTY_IODIR : 0 ) );
 }
 
 
@@ -120,14 +144,18 @@ void GPIOClass::pinMode( uint8_t pin, uint8_t mode ) {
  */
 void GPIOClass::digitalWrite( uint8_t pin, uint8_t value ) {
   if ( pin > 7 ) return;            // Silently ignore non-existing pins.
-  if ( value ) {
-    if ( _outputState & pinMask( pin ) ) return;  // Already on.
-    _outputState |= pinMask( pin );
-  } else {
-    if ( ( _outputState & pinMask( pin ) ) == 0 ) return; // Already off.
-    _outputState &= ~pinMask( pin );
-  }
-  writeRegister( registerGPIO, _outputState );
+  writePort( pinMask( pin ), value ? 0xff : 0 );
+}
+
+
+/**
+ * Write the masked bits of value on the pins
+ */
+void GPIOClass::writePort( uint8_t mask, uint8_t value ) {
+  uint8_t outputState = ( _outputState & ~mask ) | ( value & mask );
+  if ( outputState == _outputState ) return;    // Already there.
+  _outputState = outputState;
+  update( DIRTY_OLAT );
 }
 
 /**
@@ -135,7 +163,94 @@ void GPIOClass::digitalWrite( uint8_t pin, uint8_t value ) {
  */
 uint8_t GPIOClass::digitalRead( uint8_t pin ) {
   if ( pin > 7 ) return LOW;          // Silently ignore non-existing pins, returning LOW.
-  return ( readRegister( registerGPIO ) & pinMask( pin ) ? HIGH : LOW );
+  return ( readGPIO() & pinMask( pin ) ? HIGH : LOW );
+}
+
+/**
+ * Read all the pins. Reads are never deferred by a batch.
+ */
+uint8_t GPIOClass::readPort() {
+  return readGPIO();
+}
+
+
+/**
+ * Enable the interrupt-on-change of the masked pins
+ */
+void GPIOClass::watchPort( uint8_t mask, uint8_t intPin ) {
+  _intPin = intPin;
+  if ( _intPin != 0xff ) ::pinMode( _intPin, INPUT );   // INT is push-pull, active low
+
+  if ( mask != _watched ) {
+    _watched = mask;
+    writeRegister( registerGPINTEN, _watched );
+  }
+
+  // Reading GPIO clears any pending interrupt
+  _portState = readRegister( registerGPIO );
+  _portChanged = 0;
+}
+
+
+/**
+ * Report the watched pins that changed since the last call.
+ *
+ * When nothing changed this is a single read of INTF (or none at all, if the
+ * INT line is wired). Otherwise INTCAP tells the state on the first change and
+ * re-arms the interrupt, and GPIO catches what changed until then. The other
+ * port reads clear the interrupt too, so they keep what they saw changing in
+ * _portChanged.
+ */
+uint8_t GPIOClass::portChanges( uint8_t * state ) {
+  if ( ( _intPin == 0xff ) || ( ::digitalRead( _intPin ) == LOW ) ) {
+    uint8_t flags = readRegister( registerINTF ) & _watched;
+    if ( flags ) {
+      uint8_t captured = readRegister( registerINTCAP );
+      _portChanged |= ( flags | ( captured ^ _portState ) ) & _watched;
+      readGPIO();
+    }
+  }
+
+  uint8_t changed = _portChanged;
+  _portChanged = 0;
+  if ( state ) *state = _portState;
+  return changed;
+}
+
+
+/**
+ * Start deferring the register writes
+ */
+void GPIOClass::beginBatch() {
+  _batching = 1;
+}
+
+
+/**
+ * Write the registers changed since beginBatch(), once each
+ */
+void GPIOClass::commitBatch() {
+  uint8_t dirty = _dirty;
+  _batching = 0;
+  _dirty = 0;
+  update( dirty );
+}
+
+
+/**
+ * Write the changed shadow registers to the chip, or remember them if batching
+ */
+void GPIOClass::update( uint8_t dirty ) {
+  if ( _batching ) {
+    _dirty |= dirty;
+    return;
+  }
+
+  // Pullups and output levels first, so that pins changing direction
+  // come up in their final state.
+  if ( dirty & DIRTY_GPPU ) writeRegister( registerGPPU, _inputPullup );
+  if ( dirty & DIRTY_OLAT ) writeRegister( registerGPIO, _outputState );
+  if ( dirty & DIRTY_IODIR ) writeRegister( registerIODIR, _direction );
 }
 
 /**
@@ -149,12 +264,12 @@ int16_t GPIOClass::timeHalfPulse( uint8_t pin ) {
   startSPI();
   (void) SPI.transfer( opcodeReadGPIO );
   (void) SPI.transfer( registerGPIO );
-  uint8_t startState = SPI.transfer( 0 ) & ourPinMask;  // Get initial state at startTime
+  uint8_t startState = trackPort( SPI.transfer( 0 ) ) & ourPinMask;  // Get initial state at startTime
 
   // Since we may be called with interrupts off we will allow maximum of "maximumHalfPulseLength" microseconds
   while ( ( waitingTime = micros() - startTime ) <= maximumHalfPulseLength ) {
     // We can use repeated read because in setup we disabled auto register address increment.
-    if ( ( SPI.transfer( 0 ) & ourPinMask ) == startState ) continue;  // Not yet, try harder ;-)
+    if ( ( trackPort( SPI.transfer( 0 ) ) & ourPinMask ) == startState ) continue;  // Not yet, try harder ;-)
     stopSPI();
     return waitingTime;
   }
@@ -164,15 +279,265 @@ int16_t GPIOClass::timeHalfPulse( uint8_t pin ) {
 }
 
 
+/**
+ * Capture the edges on a pin, in a single SPI session.
+ */
+uint16_t GPIOClass::captureEdges( uint8_t pin, uint32_t * timestamps, uint16_t maxEdges,
+                                  uint32_t window, uint8_t * level ) {
+  uint16_t edges = 0;
+  uint8_t ourPinMask = pinMask( pin );
+
+  if ( pin > 7 ) return 0;            // Silently ignore non-existing pins.
+
+  startSPI();
+  (void) SPI.transfer( opcodeReadGPIO );
+  (void) SPI.transfer( registerGPIO );
+
+  uint32_t startTime = micros();
+  uint32_t lastYield = startTime;
+  uint8_t state = trackPort( SPI.transfer( 0 ) ) & ourPinMask;
+  if ( level ) *level = state ? HIGH : LOW;
+
+  while ( edges < maxEdges ) {
+    uint32_t time = micros();
+    if ( time - startTime >= window ) break;
+
+    // We can use repeated read because in setup we disabled auto register address increment.
+    uint8_t sample = trackPort( SPI.transfer( 0 ) ) & ourPinMask;
+    if ( sample != state ) {
+      state = sample;
+      timestamps[edges++] = time - startTime;
+    }
+
+    // Keep the soft WDT happy on long windows. Nothing else uses the SPI bus
+    // from yield(), so the chip can stay selected.
+    if ( time - lastYield >= captureYieldInterval ) {
+      yield();
+      lastYield = micros();
+    }
+  }
+
+  stopSPI();
+  return edges;
+}
+
+
+/**
+ * Capture the changes on the masked pins, in a single SPI session.
+ */
+uint16_t GPIOClass::capturePort( uint8_t mask, uint32_t * timestamps, uint8_t * states,
+                                 uint16_t maxChanges, uint32_t window, uint8_t * initial ) {
+  uint16_t changes = 0;
+
+  startSPI();
+  (void) SPI.transfer( opcodeReadGPIO );
+  (void) SPI.transfer( registerGPIO );
+
+  uint32_t startTime = micros();
+  uint32_t lastYield = startTime;
+  uint8_t state = trackPort( SPI.transfer( 0 ) ) & mask;
+  if ( initial ) *initial = state;
+
+  while ( changes < maxChanges ) {
+    uint32_t time = micros();
+    if ( time - startTime >= window ) break;
+
+    // Same loop as captureEdges(), only comparing the whole masked port.
+    uint8_t sample = trackPort( SPI.transfer( 0 ) ) & mask;
+    if ( sample != state ) {
+      state = sample;
+      timestamps[changes] = time - startTime;
+      states[changes++] = state;
+    }
+
+    if ( time - lastYield >= captureYieldInterval ) {
+      yield();
+      lastYield = micros();
+    }
+  }
+
+  stopSPI();
+  return changes;
+}
+
+
+/**
+ * Clock a byte out on the I2C bus, streaming the IODIR waveform.
+ */
+uint8_t GPIOClass::i2cWrite( uint8_t sda, uint8_t scl, uint8_t data, uint8_t halfPeriod, uint16_t timeout ) {
+  uint8_t sdaMask = pinMask( sda );
+  uint8_t sclMask = pinMask( scl );
+  uint8_t wave[27];
+  uint8_t port;
+
+  if ( ( sda > 7 ) || ( scl > 7 ) ) return GPIO_I2C_TIMEOUT;    // Not on the chip.
+
+  uint32_t startTime = micros();
+  uint8_t sdaLevel = _direction & sdaMask;
+  uint8_t low = i2cBegin( sda, scl );
+
+  // Three steps per bit, so SDA only changes while SCL is low (otherwise the
+  // slave sees a START or a STOP): SCL low with the previous bit still on
+  // SDA, then the new bit on SDA, then SCL released. The ACK is a ninth bit
+  // with SDA released.
+  for ( uint8_t i = 0; i < 9; i++ ) {
+    uint8_t bit = ( ( i == 8 ) || ( data & ( 0x80 >> i ) ) ) ? sdaMask : 0;
+    wave[3 * i] = low | sdaLevel;
+    wave[3 * i + 1] = low | bit;
+    wave[3 * i + 2] = low | bit | sclMask;
+    sdaLevel = bit;
+  }
+
+  // The slave may stretch the clock on the first bit, after the previous
+  // byte. The rest of the byte and the ACK clock go in one transaction, and
+  // the ACK is read with SCL high.
+  i2cWave( wave, 3, halfPeriod );
+  if ( i2cSample( sclMask, timeout, &port ) ) return GPIO_I2C_TIMEOUT;
+  i2cWave( wave + 3, 24, halfPeriod );
+  if ( i2cSample( sclMask, timeout, &port ) ) return GPIO_I2C_TIMEOUT;
+
+  // Keep SCL low between bytes, with SDA still released
+  i2cWave( wave + 25, 1, 0 );
+  i2cEnd( startTime, 9 );
+
+  return ( port & sdaMask ) ? GPIO_I2C_NACK : GPIO_I2C_ACK;
+}
+
+
+/**
+ * Clock a byte in from the I2C bus, streaming the IODIR waveform.
+ */
+uint8_t GPIOClass::i2cRead( uint8_t sda, uint8_t scl, uint8_t * data, uint8_t sendAck,
+                            uint8_t halfPeriod, uint16_t timeout ) {
+  uint8_t sdaMask = pinMask( sda );
+  uint8_t sclMask = pinMask( scl );
+  uint8_t wave[3];
+  uint8_t port;
+
+  *data = 0;
+  if ( ( sda > 7 ) || ( scl > 7 ) ) return GPIO_I2C_TIMEOUT;    // Not on the chip.
+
+  uint32_t startTime = micros();
+  uint8_t low = i2cBegin( sda, scl );
+
+  // SDA released, and sampled at the end of every SCL high
+  wave[0] = low | sdaMask;
+  wave[1] = low | sdaMask | sclMask;
+  for ( uint8_t i = 0; i < 8; i++ ) {
+    i2cWave( wave, 2, halfPeriod );
+    if ( i2cSample( sclMask, timeout, &port ) ) return GPIO_I2C_TIMEOUT;
+    *data = ( *data << 1 ) | ( ( port & sdaMask ) ? 1 : 0 );
+  }
+
+  // ACK by driving SDA low, or NACK by leaving it released. SDA only
+  // changes once SCL is low, like the bits of i2cWrite().
+  wave[0] = low | sdaMask;
+  wave[1] = sendAck ? low : ( low | sdaMask );
+  wave[2] = wave[1] | sclMask;
+  i2cWave( wave, 3, halfPeriod );
+  if ( i2cSample( sclMask, timeout, &port ) ) return GPIO_I2C_TIMEOUT;
+
+  // Keep SCL low between bytes
+  i2cWave( wave + 1, 1, 0 );
+  i2cEnd( startTime, 9 );
+
+  return GPIO_I2C_ACK;
+}
+
+
+/**
+ * The SCL frequency of the last byte
+ */
+uint32_t GPIOClass::i2cClock() {
+  return _i2cClock;
+}
+
+
+/**
+ * Start an I2C byte: make sure both lines are driven low when they are
+ * outputs. Returns the IODIR value with both lines low.
+ */
+uint8_t GPIOClass::i2cBegin( uint8_t sda, uint8_t scl ) {
+  uint8_t mask = pinMask( sda ) | pinMask( scl );
+
+  if ( _outputState & mask ) {
+    _outputState &= ~mask;
+    writeRegister( registerGPIO, _outputState );
+  }
+
+  return _direction & ~mask;
+}
+
+
+/**
+ * Write a sequence of IODIR values in one selection of the chip, keeping the
+ * last one in the shadow register. This relies on the disabled auto register
+ * address increment.
+ */
+void GPIOClass::i2cWave( const uint8_t * wave, uint8_t count, uint8_t halfPeriod ) {
+  startSPI();
+  (void) SPI.transfer( opcodeWriteGPIO );
+  (void) SPI.transfer( registerIODIR );
+  for ( uint8_t i = 0; i < count; i++ ) {
+    (void) SPI.transfer( wave[i] );
+    if ( halfPeriod ) delayMicroseconds( halfPeriod );
+  }
+  stopSPI();
+  _direction = wave[count - 1];
+}
+
+
+/**
+ * Read the port once SCL is high, waiting for a slave that stretches the
+ * clock. Returns non-zero if it timed out.
+ */
+uint8_t GPIOClass::i2cSample( uint8_t sclMask, uint16_t timeout, uint8_t * port ) {
+  uint32_t startTime = millis();
+
+  startSPI();
+  (void) SPI.transfer( opcodeReadGPIO );
+  (void) SPI.transfer( registerGPIO );
+  while ( !( ( *port = trackPort( SPI.transfer( 0 ) ) ) & sclMask ) ) {
+    if ( millis() - startTime > timeout ) {
+      stopSPI();
+      return 1;
+    }
+  }
+  stopSPI();
+  return 0;
+}
+
+
+/**
+ * Finish an I2C byte, keeping the clock it ran at.
+ */
+void GPIOClass::i2cEnd( uint32_t startTime, uint8_t bits ) {
+
+  uint32_t elapsed = micros() - startTime;
+  _i2cClock = elapsed ? ( bits * 1000000UL ) / elapsed : 0;
+}
+
+
 /**
  * Write "value" to MCP23S08 register "reg".
  */
 void GPIOClass::writeRegister( uint8_t reg, uint8_t value ) {
+  writeRegisters( reg, &value, 1 );
+}
+
+
+/**
+ * Write "count" values to consecutive MCP23S08 registers, starting at "reg".
+ * Only works while the auto register address increment is enabled.
+ */
+void GPIOClass::writeRegisters( uint8_t reg, const uint8_t * values, uint8_t count ) {
   startSPI();
 
   (void) SPI.transfer( opcodeWriteGPIO );
   (void) SPI.transfer( reg );
-  (void) SPI.transfer( value );
+  for ( uint8_t i = 0; i < count; i++ ) {
+    (void) SPI.transfer( values[i] );
+  }
 
   stopSPI();
 }
@@ -196,18 +561,37 @@ uint8_t GPIOClass::readRegister( uint8_t reg ) {
 
 
 /**
- * Prepare SPI bus and select the MCP23S08,
+ * Read the port data register, see trackPort().
+ */
+uint8_t GPIOClass::readGPIO() {
+  return trackPort( readRegister( registerGPIO ) );
+}
+
+
+/**
+ * Every read of the port data clears the interrupt-on-change of the chip.
+ * While pins are watched, keep the changes it saw for portChanges().
+ */
+uint8_t GPIOClass::trackPort( uint8_t port ) {
+  if ( _watched ) {
+    _portChanged |= ( port ^ _portState ) & _watched;
+    _portState = port;
+  }
+  return port;
+}
+
+
+/**
+ * Prepare SPI bus (if the radio used it last) and select the MCP23S08.
  */
 void GPIOClass::startSPI() {
-  SPI.beginTransaction( SPISettings( 12000000, MSBFIRST, SPI_MODE0 ) );
-  ::digitalWrite( UPIN_GPIO, LOW );
+  SPIBus.select( SPI_DEVICE_GPIO );
 }
 
 
 /**
- * Deselect the MCP23S08, and free the SPI bus.
+ * Deselect the MCP23S08.
  */
 void GPIOClass::stopSPI() {
-  ::digitalWrite( UPIN_GPIO, HIGH );
-  SPI.endTransaction();
+  SPIBus.deselect( SPI_DEVICE_GPIO );
 }
@@ -29,6 +29,11 @@
 
 #define MCP23S08_ADDRESS 0x21
 
+// Results of i2cWrite() / i2cRead(), the same as SoftWire::result_t
+#define GPIO_I2C_ACK        0
+#define GPIO_I2C_NACK       1
+#define GPIO_I2C_TIMEOUT    2
+
 /**
    Shorthand to the GPIO expansion interface
 */
@@ -65,6 +70,48 @@ class GPIOClass {
      */
     uint8_t digitalRead( uint8_t pin );
 
+    /**
+     * Read all 8 pins at once (bit 0 is pin 0)
+     */
+    uint8_t readPort();
+
+    /**
+     * Write the bits of `value` selected by `mask` on the pins, at once
+     */
+    void writePort( uint8_t mask, uint8_t value );
+
+    /**
+     * Set the direction of all the pins selected by `mask`, at once
+     */
+    void pinModePort( uint8_t mask, uint8_t mode );
+
+    /**
+     * Defer the register writes of `pinMode`, `digitalWrite`, `writePort`
+     * and `pinModePort` until `commitBatch()`, which writes every changed
+     * register once. Batches do not nest.
+     */
+    void beginBatch();
+    void commitBatch();
+
+    /**
+     * Watch the pins selected by `mask` for changes, with the interrupt-on-change
+     * of the chip. If its INT line is wired to an ESP8266 pin, pass that as
+     * `intPin`, and `portChanges()` won't use the SPI bus until it's active.
+     */
+    void watchPort( uint8_t mask, uint8_t intPin = 0xff );
+
+    /**
+     * The watched pins that changed since the last call, as a mask, and their
+     * state in `state`. Pins that changed and changed back between two calls
+     * are included, with their current state.
+     *
+     * Reading the port (`digitalRead()`, `readPort()`, the captures, I2C...)
+     * clears the interrupt of the chip, so the changes those reads see are
+     * kept for the next call. A pulse that comes and goes before such a read
+     * is lost.
+     */
+    uint8_t portChanges( uint8_t * state = NULL );
+
 
     /**
      * Time a half pulse in Micros
@@ -72,6 +119,55 @@ class GPIOClass {
     static const uint16_t maximumHalfPulseLength = 500;  // micro seconds
     int16_t timeHalfPulse( uint8_t pin );
 
+    /**
+     * Capture the edges on a pin for `window` micro seconds, or until
+     * `maxEdges` timestamps (in micro seconds from the start) are stored in
+     * `timestamps`. The pin level at the start is stored in `level`.
+     * Returns the number of edges captured.
+     *
+     * The chip stays selected and GPIO is read back to back for the whole
+     * window, yielding every `captureYieldInterval` micro seconds; an edge
+     * during a yield is timestamped when it returns.
+     */
+    static const uint32_t captureYieldInterval = 20000;  // micro seconds
+    uint16_t captureEdges( uint8_t pin, uint32_t * timestamps, uint16_t maxEdges,
+                           uint32_t window, uint8_t * level = NULL );
+
+    /**
+     * Capture the changes on all the pins selected by `mask` at once, like
+     * `captureEdges()`. Every time one of them changes, its timestamp goes in
+     * `timestamps` and the (masked) port state in `states`. The port state at
+     * the start is stored in `initial`. Returns the number of changes.
+     */
+    uint16_t capturePort( uint8_t mask, uint32_t * timestamps, uint8_t * states,
+                          uint16_t maxChanges, uint32_t window, uint8_t * initial = NULL );
+
+    /**
+     * Clock a byte out on an I2C bus on pins `sda` and `scl` (open drain,
+     * driven with their direction), and return the ACK of the slave.
+     *
+     * The IODIR values of the whole byte are computed first and written back
+     * to back in one SPI transaction, `halfPeriod` micro seconds apart. Every
+     * bit takes three of them (SCL low, then SDA, then SCL released) so SDA
+     * never changes while SCL is high, and SCL stays low for two of them. The
+     * chip is only re-selected to read SCL and SDA, on the first bit (clock
+     * stretching) and on the ACK. Waiting for stretching gives up after
+     * `timeout` milli seconds.
+     */
+    uint8_t i2cWrite( uint8_t sda, uint8_t scl, uint8_t data, uint8_t halfPeriod, uint16_t timeout );
+
+    /**
+     * Clock a byte in from an I2C bus and ACK it if `sendAck` is set, in the
+     * same way. SCL is read with SDA, so every bit allows stretching.
+     */
+    uint8_t i2cRead( uint8_t sda, uint8_t scl, uint8_t * data, uint8_t sendAck,
+                     uint8_t halfPeriod, uint16_t timeout );
+
+    /**
+     * The SCL frequency (Hz) achieved by the last i2cWrite() / i2cRead()
+     */
+    uint32_t i2cClock();
+
   private:
 
     // Master (shadow registers)
@@ -79,20 +175,44 @@ class GPIOClass {
     uint8_t _inputPullup;       // registerGPPU content
     uint8_t _outputState;       // registerOLAT content
 
+    // Batching
+    uint8_t _batching;          // Inside beginBatch() / commitBatch()
+    uint8_t _dirty;             // Shadow registers changed in the batch
+
+    // Change detection
+    uint8_t _watched;           // registerGPINTEN content
+    uint8_t _intPin;            // ESP8266 pin of the INT line, or 0xff
+    uint8_t _portState;         // Port state last read
+    uint8_t _portChanged;       // Watched pins the port reads saw changing
+
+    // I2C engine
+    uint32_t _i2cClock;         // SCL frequency of the last byte
+
     // SPI operation codes and address
     const uint8_t opcodeReadGPIO = ( MCP23S08_ADDRESS << 1 ) | 1;
     const uint8_t opcodeWriteGPIO = ( MCP23S08_ADDRESS << 1 );
 
     // Registers in MCP23S08
-    const uint8_t registerIODIR = 0x00;     // IO Direction
-    const uint8_t registerIOCON = 0x05;     // IO Control
-    const uint8_t registerGPPU  = 0x06;     // Input pullups
-    const uint8_t registerGPIO  = 0x09;     // Port data (read INPUT)
-
+    const uint8_t registerIODIR   = 0x00;   // IO Direction
+    const uint8_t registerGPINTEN = 0x02;   // Interrupt-on-change enable
+    const uint8_t registerIOCON   = 0x05;   // IO Control
+    const uint8_t registerGPPU    = 0x06;   // Input pullups
+    const uint8_t registerINTF    = 0x07;   // Interrupt flags (pins that changed)
+    const uint8_t registerINTCAP  = 0x08;   // Port data captured on interrupt
+    const uint8_t registerGPIO    = 0x09;   // Port data (read INPUT)
+
+    void update( uint8_t dirty );
     void writeRegister( uint8_t reg, uint8_t value );
+    void writeRegisters( uint8_t reg, const uint8_t * values, uint8_t count );
     uint8_t readRegister( uint8_t reg );
+    uint8_t readGPIO();
+    uint8_t trackPort( uint8_t port );
     void startSPI();
     void stopSPI();
+    uint8_t i2cBegin( uint8_t sda, uint8_t scl );
+    void i2cWave( const uint8_t * wave, uint8_t count, uint8_t halfPeriod );
+    uint8_t i2cSample( uint8_t sclMask, uint16_t timeout, uint8_t * port );
+    void i2cEnd( uint32_t startTime, uint8_t bits );
 
 };
 
@@ -37,8 +37,10 @@
 
 #include "../util/SystemConfig.hpp"
 #include "../util/RTCMem.hpp"
+#include "../util/Checksums.hpp"
 #include "../Pinout.hpp"
 #include "LoRa.hpp"
+#include "Power.hpp"
 
 #define DEBUG_CONTEXT "LoRa"
 #include "../util/Debug.hpp"
@@ -56,6 +58,16 @@ const lmic_pinmap lmic_pins = {
   .dio = {UPIN_RFM_DIO0, UPIN_RFM_DIO1, LMIC_UNUSED_PIN},
 };
 
+/**
+ * Light-sleep between LMIC jobs, if enabled in the configuration
+ */
+u4_t hal_lightSleep(u4_t us) {
+  if (!system_config.lora.light_sleep) {
+    return 0;
+  }
+  return Power.lightSleep(us);
+}
+
 /**
  * Structure for persisting the LoRa OTAA configuration
  */
@@ -66,7 +78,71 @@ struct OTAAPersistence {
   uint8_t   artKey[16];
   uint32_t  seqnoDn;
   uint32_t  seqnoUp;
-} persistedConfig;
+};
+
+/**
+ * The persisted OTAA configuration. Frame counter updates are only written
+ * to the RTC memory when the LoRa subsystem shuts down (i.e. before sleeping)
+ */
+RTCMemPersist<OTAAPersistence> persistedConfig(RTCMEM_SLOT_LORAPERSIST);
+
+/**
+ * Version of the `MACSnapshot` structure, bump when changing it
+ */
+#define MAC_SNAPSHOT_VERSION  2
+
+/**
+ * Snapshot of the LMIC MAC state that doesn't survive `LMIC_reset`. Times are
+ * kept as the milliseconds remaining when waking up from sleep.
+ */
+struct MACSnapshot {
+  uint8_t   version;
+  uint8_t   datarate;
+  int8_t    adrTxPow;
+  int8_t    adrAckReq;
+  uint8_t   dn2Dr;
+  uint8_t   rxDelay;
+  uint8_t   globalDutyRate;
+  uint8_t   txChnl;
+  uint32_t  devaddr;
+  uint32_t  dn2Freq;
+  uint32_t  globalDutyAvail;
+  uint16_t  channelMap;
+  uint16_t  crc;
+  struct {
+    uint16_t  txcap;
+    int8_t    txpow;
+    uint8_t   lastchnl;
+    uint32_t  avail;
+  } bands[MAX_BANDS];
+  uint32_t  channelFreq[MAX_CHANNELS];
+  uint16_t  channelDrMap[MAX_CHANNELS];
+};
+
+static_assert(sizeof(MACSnapshot) <= 38 * sizeof(uint32_t), "MACSnapshot does not fit RTCMEM_SLOT_LORAMAC");
+
+/**
+ * The persisted MAC state
+ */
+RTCMemPersist<MACSnapshot> persistedMAC(RTCMEM_SLOT_LORAMAC);
+
+/**
+ * Return the milliseconds remaining until `time`, after sleeping `sleepMs`
+ */
+static uint32_t remainingAfterSleep(ostime_t time, uint32_t sleepMs) {
+  ostime_t delta = time - os_getTime();
+  if (delta <= 0) return 0;
+  uint32_t ms = osticks2ms(delta);
+  return (ms > sleepMs) ? (ms - sleepMs) : 0;
+}
+
+/**
+ * Return the time, `ms` milliseconds after the wake-up
+ */
+static ostime_t timeAfterWakeup(uint32_t ms) {
+  uint32_t awake = millis();
+  return os_getTime() + ((ms > awake) ? ms2osticks(ms - awake) : 0);
+}
 
 // This EUI must be in little-endian format, so least-significant-byte
 // first. When copying an EUI from ttnctl output, this means to reverse
@@ -120,18 +196,18 @@ void onEvent(ev_t ev) {
         logDebug("Persisting OTAA session");
 
         // Take a snapshot of the session information
-        persistedConfig.netid = LMIC.netid;
-        persistedConfig.devaddr = LMIC.devaddr;
-        persistedConfig.seqnoDn = LMIC.seqnoDn;
-        persistedConfig.seqnoUp = LMIC.seqnoUp;
-        memcpy(persistedConfig.nwkKey, LMIC.nwkKey, sizeof(persistedConfig.nwkKey));
-        memcpy(persistedConfig.artKey, LMIC.artKey, sizeof(persistedConfig.artKey));
+        persistedConfig.value.netid = LMIC.netid;
+        persistedConfig.value.devaddr = LMIC.devaddr;
+        persistedConfig.value.seqnoDn = LMIC.seqnoDn;
+        persistedConfig.value.seqnoUp = LMIC.seqnoUp;
+        memcpy(persistedConfig.value.nwkKey, LMIC.nwkKey, sizeof(persistedConfig.value.nwkKey));
+        memcpy(persistedConfig.value.artKey, LMIC.artKey, sizeof(persistedConfig.value.artKey));
 
         // Persist state on the RTC memory (persisted across deep sleeps)
-        if (rtcMemWrite(RTCMEM_SLOT_LORAPERSIST, 0, persistedConfig) != 0) {
-          logDebug("Marking device as OTAA-Joined");
-          rtcMemFlagSet(RTCMEM_SLOT_BOOTFLAGS, BOOTFLAG_LORA_JOINED);
-        }
+        // right away, since the joined flag must match its contents
+        persistedConfig.flush();
+        logDebug("Marking device as OTAA-Joined");
+        rtcMemFlagSet(RTCMEM_SLOT_BOOTFLAGS, BOOTFLAG_LORA_JOINED);
       }
 
       // If the user wants to know when we are joined, call-out now
@@ -166,18 +242,21 @@ void onEvent(ev_t ev) {
 
       // If we are using OTAA mode, it means we are using the RTC memory
       // to keep track of the current state. Now it's a good time to update the
-      // frame counters.
+      // frame counters (they are flushed when the LoRa subsystem shuts down).
       if (system_config.lora.mode == LORA_TTN_OTAA) {
-        persistedConfig.seqnoDn = LMIC.seqnoDn;
-        persistedConfig.seqnoUp = LMIC.seqnoUp;
-        rtcMemWrite(RTCMEM_SLOT_LORAPERSIST, 0, persistedConfig);
+        persistedConfig.value.seqnoDn = LMIC.seqnoDn;
+        persistedConfig.value.seqnoUp = LMIC.seqnoUp;
       }
 
-      // We managed to send some data, reset possible pending re-try
+      // We managed to send some data, release the frame from the queue
       if (LoRa.flags.pending) {
         LoRa.flags.pending = 0;
-      }
-      if (LoRa.loraCb != NULL) {
+        if (LMIC.dataLen) {
+          LoRa.releaseFrame(LoRa.active, EV_TXCOMPLETE, &LMIC.frame[LMIC.dataBeg], LMIC.dataLen);
+        } else {
+          LoRa.releaseFrame(LoRa.active, EV_TXCOMPLETE, NULL, 0);
+        }
+      } else if (LoRa.loraCb != NULL) {
         if (LMIC.dataLen) {
           LoRa.loraCb(EV_TXCOMPLETE, &LMIC.frame[LMIC.dataBeg], LMIC.dataLen);
         } else {
@@ -198,11 +277,10 @@ void onEvent(ev_t ev) {
 
       // If we are using OTAA mode, it means we are using the RTC memory
       // to keep track of the current state. Now it's a good time to update the
-      // frame counters.
+      // frame counters (they are flushed when the LoRa subsystem shuts down).
       if (system_config.lora.mode == LORA_TTN_OTAA) {
-        persistedConfig.seqnoDn = LMIC.seqnoDn;
-        persistedConfig.seqnoUp = LMIC.seqnoUp;
-        rtcMemWrite(RTCMEM_SLOT_LORAPERSIST, 0, persistedConfig);
+        persistedConfig.value.seqnoDn = LMIC.seqnoDn;
+        persistedConfig.value.seqnoUp = LMIC.seqnoUp;
       }
 
       break;
@@ -251,17 +329,17 @@ void LoRaClass::begin() {
     // last saved information and resume the session.
     if (rtcMemFlagGet(RTCMEM_SLOT_BOOTFLAGS, BOOTFLAG_LORA_JOINED) != 0) {
       logDebug("The device is OTAA-Joined, reading session info");
-      if (rtcMemRead(RTCMEM_SLOT_LORAPERSIST, 0, persistedConfig) != 0) {
+      if (persistedConfig.load() != 0) {
         logDebug("Resuming OTAA session");
 
         // Resume session
-        LMIC_setSession(persistedConfig.netid, persistedConfig.devaddr,
-                     (uint8_t*)persistedConfig.nwkKey,
-                     (uint8_t*)persistedConfig.artKey);
+        LMIC_setSession(persistedConfig.value.netid, persistedConfig.value.devaddr,
+                     (uint8_t*)persistedConfig.value.nwkKey,
+                     (uint8_t*)persistedConfig.value.artKey);
 
         // Restore frame counters
-        LMIC.seqnoDn = persistedConfig.seqnoDn;
-        LMIC.seqnoUp = persistedConfig.seqnoUp;
+        LMIC.seqnoDn = persistedConfig.value.seqnoDn;
+        LMIC.seqnoUp = persistedConfig.value.seqnoUp;
 
         // Configure channels
         configureTTNChannels();
@@ -271,6 +349,9 @@ void LoRaClass::begin() {
   }
 
 
+  // Continue where the MAC left off before sleeping
+  restoreState();
+
   // Enable loop
   flags.configured = 1;
   flags.pending = 0;
@@ -287,6 +368,13 @@ void LoRaClass::end() {
 
   flags.configured = 0;
   LMIC_shutdown();
+
+  // Write back the frame counters that changed since the last flush
+  if ((system_config.lora.mode == LORA_TTN_OTAA) &&
+      (rtcMemFlagGet(RTCMEM_SLOT_BOOTFLAGS, BOOTFLAG_LORA_JOINED) != 0)) {
+    uint8_t words = persistedConfig.flush();
+    logDebug("Persisted %d changed words", words);
+  }
   logDebug("Shut down");
 }
 
@@ -299,25 +387,170 @@ void LoRaClass::step() {
   }
 
   if (!flags.configured) return;
-  if (flags.pending && (millis() > pending.timeout_ts)) {
-    pending.timeout_ts = millis() + pending.timeout;
-    if (--pending.retries == 0) {
+  if (flags.pending && (millis() > timeout_ts)) {
+    timeout_ts = millis() + nextTxTime() + active->timeout;
+    if (--active->retries == 0) {
       // Check if we ran out of retries
       logDebug("Retries exceeded");
-      if (loraCb != NULL) {
-        loraCb(0, NULL, 0);
-        loraCb = NULL;
-      }
+      flags.pending = 0;
+      releaseFrame(active, 0, NULL, 0);
+    } else if (active->expires_ts && (millis() > active->expires_ts)) {
+      // Don't insist on frames that are no longer relevant
+      logDebug("Transmission expired");
+      flags.pending = 0;
+      releaseFrame(active, 0, NULL, 0);
     } else {
       logDebug("Transmission timed out. Retrying...");
-      sendRaw(pending.data, pending.len);
+      sendRaw((const char *)active->data, active->len);
     }
   }
 
+  // Drop the queued frames that expired before they got a chance to be sent
+  for (uint8_t i = 0; i < LORA_QUEUE_SIZE; ++i) {
+    LoRaQueuedFrame * frame = &queue[i];
+    if (!frame->used || (flags.pending && (frame == active))) continue;
+    if (frame->expires_ts && (millis() > frame->expires_ts)) {
+      logDebug("Dropping expired frame");
+      releaseFrame(frame, 0, NULL, 0);
+    }
+  }
+
+  // Send the next frame in the queue, if LMIC is free
+  dispatch();
+
   // Handle LMIC events
   os_runloop_once();
 }
 
+/**
+ * Hand over the next queued frame to LMIC, if nothing is in progress
+ */
+void LoRaClass::dispatch() {
+  if (!flags.configured || flags.pending) return;
+  if (LMIC.opmode & OP_TXRXPEND) return;
+
+  LoRaQueuedFrame * frame = nextFrame();
+  if (frame == NULL) return;
+
+  // Don't start counting the timeout before the duty cycle allows us to send
+  active = frame;
+  flags.pending = 1;
+  timeout_ts = millis() + nextTxTime() + frame->timeout;
+  sendRaw((const char *)frame->data, frame->len);
+}
+
+/**
+ * Pick the next frame to send: highest priority first, then oldest first
+ */
+LoRaQueuedFrame * LoRaClass::nextFrame() {
+  LoRaQueuedFrame * best = NULL;
+  for (uint8_t i = 0; i < LORA_QUEUE_SIZE; ++i) {
+    LoRaQueuedFrame * frame = &queue[i];
+    if (!frame->used) continue;
+    if ((best == NULL) || (frame->priority > best->priority) ||
+        ((frame->priority == best->priority) && ((int16_t)(frame->seq - best->seq) < 0))) {
+      best = frame;
+    }
+  }
+  return best;
+}
+
+/**
+ * Release a queued frame and notify its callback
+ */
+void LoRaClass::releaseFrame(LoRaQueuedFrame * frame, int status, uint8_t * data, uint8_t len) {
+  fnLoRaDataCallback cb = frame->cb;
+
+  // Free the slot before calling-out, since the callback might queue again
+  frame->used = 0;
+  frame->cb = NULL;
+  if (cb != NULL) {
+    cb(status, data, len);
+  }
+}
+
+/**
+ * Return the number of frames waiting in the uplink queue
+ */
+uint8_t LoRaClass::queueLength() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < LORA_QUEUE_SIZE; ++i) {
+    if (queue[i].used) ++count;
+  }
+  return count;
+}
+
+/**
+ * Return the number of milliseconds until the duty-cycle limitations of the
+ * LoRa bands allow the next uplink to go out
+ */
+uint32_t LoRaClass::nextTxTime() {
+  if (system_config.lora.mode == LORA_DISABLED) {
+    return 0;
+  }
+  if (!flags.configured) return 0;
+
+  // Same as LMIC's `nextTx`: pick the band that becomes available first,
+  // among the ones that have a channel usable with the current data rate.
+  // Times are compared relative to now, since the tick counter wraps.
+  ostime_t now = os_getTime();
+  ostime_t wait = sec2osticks(28800);
+  for (u1_t bi = 0; bi < MAX_BANDS; ++bi) {
+    for (u1_t ci = 0; ci < MAX_CHANNELS; ++ci) {
+      if ((LMIC.channelMap & (1 << ci)) &&
+          (LMIC.channelDrMap[ci] & (1 << (LMIC.datarate & 0xF))) &&
+          ((LMIC.channelFreq[ci] & 0x3) == bi)) {
+        if (LMIC.bands[bi].avail - now < wait) {
+          wait = LMIC.bands[bi].avail - now;
+        }
+        break;
+      }
+    }
+  }
+
+  // Then respect the global duty cycle, if set by the network
+  if ((LMIC.globalDutyRate != 0) && (LMIC.globalDutyAvail - now > wait)) {
+    wait = LMIC.globalDutyAvail - now;
+  }
+
+  if (wait <= 0) return 0;
+  return osticks2ms(wait);
+}
+
+/**
+ * Return the airtime (in milliseconds) of an uplink carrying `len` bytes
+ */
+uint32_t LoRaClass::airtimeCost(size_t len) {
+  if (system_config.lora.mode == LORA_DISABLED) {
+    return 0;
+  }
+
+  // Until LMIC is configured, assume the data rate from the configuration
+  dr_t dr = flags.configured ? (dr_t)LMIC.datarate
+                             : (dr_t)(system_config.lora.tx_sf - 1);
+
+  // MHDR (1), DevAddr (4), FCtrl (1), FCnt (2), FPort (1) and MIC (4)
+  return osticks2ms(calcAirTime(updr2rps(dr), len + 13));
+}
+
+/**
+ * Return the largest payload (in bytes) an uplink can carry with the current
+ * data rate, capped to what the uplink queue can hold
+ */
+uint8_t LoRaClass::maxPayload() {
+  if (system_config.lora.mode == LORA_DISABLED) {
+    return 0;
+  }
+
+  // Until LMIC is configured, assume the data rate from the configuration
+  dr_t dr = flags.configured ? (dr_t)LMIC.datarate
+                             : (dr_t)(system_config.lora.tx_sf - 1);
+
+  // Same frame overhead as in `airtimeCost`
+  uint8_t len = LMIC_maxFrameLen(dr) - 13;
+  return (len > LORA_MAX_PAYLOAD) ? LORA_MAX_PAYLOAD : len;
+}
+
 /**
  * Send something over the radio
  *
@@ -329,37 +562,84 @@ size_t LoRaClass::sendRaw(const char * data, size_t len) {
   }
 
   if (LMIC.opmode & OP_TXRXPEND) {
-    logDebug("Not sending %d bytes: pending Rx/Tx", len);
+    logDebug("Not sending %u bytes: pending Rx/Tx", (unsigned)len);
     return 0;
   }
   else {
-    logDebug("Sending %d bytes", len);
+    logDebug("Sending %u bytes", (unsigned)len);
     LMIC_setTxData2(1, (uint8_t*)data, len, 0);
     return len;
   }
 }
 
 /**
- * Send something, but keep checking if the transmission was successful
+ * Queue something for sending, and keep checking if the transmission was
+ * successful
  */
-void LoRaClass::sendManaged(const char * data, size_t len,
-                   uint16_t retries, uint16_t timeout) {
+size_t LoRaClass::sendManaged(const char * data, size_t len,
+                   uint16_t retries, uint16_t timeout,
+                   LORA_PRIORITY_t priority, uint32_t ttl) {
+  fnLoRaDataCallback cb = loraCb;
+  fnLoRaDataCallback droppedCb = NULL;
+  LoRaQueuedFrame * frame = NULL;
+  loraCb = NULL;
+
   if (system_config.lora.mode == LORA_DISABLED) {
-    return;
+    return 0;
+  }
+  if (len > LORA_MAX_PAYLOAD) {
+    logDebug("Not queuing %u bytes: frame too big", (unsigned)len);
+    if (cb != NULL) cb(0, NULL, 0);
+    return 0;
   }
 
-  // Schedule managed transmission
-  pending.data = data;
-  pending.len = len;
-  pending.retries = retries;
-  pending.timeout = timeout;
-  flags.pending = 1;
+  // Find a free slot in the frame pool
+  for (uint8_t i = 0; i < LORA_QUEUE_SIZE; ++i) {
+    if (!queue[i].used) {
+      frame = &queue[i];
+      break;
+    }
+  }
 
-  // Schedule timeout
-  pending.timeout_ts = millis() + timeout;
+  // If the queue is full, make room by evicting the oldest of the least
+  // important frames, as long as it's not more important than this one
+  if (frame == NULL) {
+    for (uint8_t i = 0; i < LORA_QUEUE_SIZE; ++i) {
+      LoRaQueuedFrame * victim = &queue[i];
+      if (flags.pending && (victim == active)) continue;
+      if ((frame == NULL) || (victim->priority < frame->priority) ||
+          ((victim->priority == frame->priority) && ((int16_t)(victim->seq - frame->seq) < 0))) {
+        frame = victim;
+      }
+    }
+    if ((frame == NULL) || (frame->priority > priority)) {
+      logDebug("Not queuing %u bytes: queue is full", (unsigned)len);
+      if (cb != NULL) cb(0, NULL, 0);
+      return 0;
+    }
+    logDebug("Queue is full, dropping oldest frame");
+    droppedCb = frame->cb;
+  }
+
+  // Copy the payload, the caller doesn't have to keep it around
+  memcpy(frame->data, data, len);
+  frame->len = len;
+  frame->priority = priority;
+  frame->retries = retries;
+  frame->timeout = timeout;
+  frame->seq = queueSeq++;
+  frame->expires_ts = (ttl == 0) ? 0 : millis() + ttl;
+  frame->cb = cb;
+  frame->used = 1;
+
+  // Let the owner of the evicted frame know it's not going to be sent
+  if (droppedCb != NULL) {
+    droppedCb(0, NULL, 0);
+  }
 
   // First attempt is asap
-  sendRaw(data, len);
+  dispatch();
+  return len;
 }
 
 /**
@@ -416,6 +696,92 @@ void LoRaClass::configureTTNChannels() {
   );
 }
 
+/**
+ * Save a snapshot of the LMIC MAC state on the RTC memory
+ */
+void LoRaClass::saveState(uint32_t sleepMs) {
+  if (system_config.lora.mode == LORA_DISABLED) {
+    return;
+  }
+
+  // Nothing worth saving without a session
+  if (LMIC.devaddr == 0) return;
+
+  MACSnapshot & snap = persistedMAC.value;
+  snap.version = MAC_SNAPSHOT_VERSION;
+  snap.datarate = LMIC.datarate;
+  snap.adrTxPow = LMIC.adrTxPow;
+  snap.adrAckReq = LMIC.adrAckReq;
+  snap.dn2Dr = LMIC.dn2Dr;
+  snap.rxDelay = LMIC.rxDelay;
+  snap.globalDutyRate = LMIC.globalDutyRate;
+  snap.txChnl = LMIC.txChnl;
+  snap.devaddr = LMIC.devaddr;
+  snap.dn2Freq = LMIC.dn2Freq;
+  snap.globalDutyAvail = remainingAfterSleep(LMIC.globalDutyAvail, sleepMs);
+  snap.channelMap = LMIC.channelMap;
+  for (u1_t i = 0; i < MAX_BANDS; ++i) {
+    snap.bands[i].txcap = LMIC.bands[i].txcap;
+    snap.bands[i].txpow = LMIC.bands[i].txpow;
+    snap.bands[i].lastchnl = LMIC.bands[i].lastchnl;
+    snap.bands[i].avail = remainingAfterSleep(LMIC.bands[i].avail, sleepMs);
+  }
+  for (u1_t i = 0; i < MAX_CHANNELS; ++i) {
+    snap.channelFreq[i] = LMIC.channelFreq[i];
+    snap.channelDrMap[i] = LMIC.channelDrMap[i];
+  }
+
+  snap.crc = 0;
+  snap.crc = crc16((uint8_t*)&snap, sizeof(MACSnapshot));
+
+  uint8_t words = persistedMAC.flush();
+  logDebug("Saved MAC state (%d changed words)", words);
+}
+
+/**
+ * Restore the LMIC MAC state saved with `saveState`
+ */
+void LoRaClass::restoreState() {
+  persistedMAC.load();
+  MACSnapshot & snap = persistedMAC.value;
+
+  // Make sure the snapshot is intact and belongs to the current session
+  uint16_t crc = snap.crc;
+  snap.crc = 0;
+  if ((crc16((uint8_t*)&snap, sizeof(MACSnapshot)) != crc) ||
+      (snap.version != MAC_SNAPSHOT_VERSION) ||
+      (snap.devaddr == 0) || (snap.devaddr != LMIC.devaddr)) {
+    return;
+  }
+
+  LMIC.datarate = snap.datarate;
+  LMIC.adrTxPow = snap.adrTxPow;
+  LMIC.adrAckReq = snap.adrAckReq;
+  LMIC.dn2Dr = snap.dn2Dr;
+  LMIC.rxDelay = snap.rxDelay;
+  LMIC.globalDutyRate = snap.globalDutyRate;
+  LMIC.txChnl = snap.txChnl;
+  LMIC.dn2Freq = snap.dn2Freq;
+  LMIC.globalDutyAvail = timeAfterWakeup(snap.globalDutyAvail);
+  LMIC.channelMap = snap.channelMap;
+  for (u1_t i = 0; i < MAX_BANDS; ++i) {
+    LMIC.bands[i].txcap = snap.bands[i].txcap;
+    LMIC.bands[i].txpow = snap.bands[i].txpow;
+    LMIC.bands[i].lastchnl = snap.bands[i].lastchnl;
+    LMIC.bands[i].avail = timeAfterWakeup(snap.bands[i].avail);
+  }
+  for (u1_t i = 0; i < MAX_CHANNELS; ++i) {
+    LMIC.channelFreq[i] = snap.channelFreq[i];
+    LMIC.channelDrMap[i] = snap.channelDrMap[i];
+  }
+  LMIC.opmode |= OP_NEXTCHNL;
+
+  // The snapshot is only good for one wake-up
+  snap.version = 0;
+  persistedMAC.flush();
+  logDebug("Restored MAC state, SF=#%d", LMIC.datarate + 1);
+}
+
 /**
  * Call the designated callback when a LoRa packet is sent
  */
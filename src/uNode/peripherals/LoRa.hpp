@@ -27,6 +27,29 @@
 #include "../Config.hpp"
 #include "../PublicDefinitions.hpp"
 
+/**
+ * Number of frames that can be queued for transmission. Can be overridden
+ * at build time (each slot costs about 64 bytes of RAM).
+ */
+#ifndef LORA_QUEUE_SIZE
+#define LORA_QUEUE_SIZE       4
+#endif
+
+/**
+ * A frame waiting in the uplink queue
+ */
+struct LoRaQueuedFrame {
+  uint8_t             data[LORA_MAX_PAYLOAD];
+  uint8_t             len;
+  uint8_t             used : 1;
+  uint8_t             priority : 2;
+  uint16_t            retries;
+  uint16_t            timeout;
+  uint16_t            seq;
+  unsigned long       expires_ts;
+  fnLoRaDataCallback  cb;
+};
+
 /**
  * The LoRA class that interfaces with the LoRa chip
  */
@@ -58,13 +81,40 @@ public:
   /**
    * Send something, but manage the transmission and if it's not sent re-try
    *
-   * /!\ It's the user's responsibility to preserve the contents of the `data`
-   *     pointer until the transmission is completed!
+   * The payload is copied into the uplink queue, so the caller is free to
+   * re-use the `data` buffer right away. The frame is sent from `step()` as
+   * soon as LMIC is idle, highest priority first. If `ttl` is non-zero, the
+   * frame is dropped if it could not be sent within `ttl` milliseconds.
    *
-   * Returns the numbers of bytes sent. 0 indicates an error.
+   * Returns the numbers of bytes queued. 0 indicates an error.
+   */
+  size_t sendManaged(const char * data, size_t len,
+                     uint16_t retries = 10, uint16_t timeout = 10000,
+                     LORA_PRIORITY_t priority = LORA_PRIORITY_NORMAL,
+                     uint32_t ttl = 0);
+
+  /**
+   * Return the number of frames waiting in the uplink queue
    */
-  void sendManaged(const char * data, size_t len,
-                   uint16_t retries = 10, uint16_t timeout = 10000);
+  uint8_t queueLength();
+
+  /**
+   * Return the number of milliseconds until the duty-cycle limitations of
+   * the LoRa bands allow the next uplink to go out
+   */
+  uint32_t nextTxTime();
+
+  /**
+   * Return the airtime (in milliseconds) of an uplink carrying `len` bytes
+   * of payload, using the current data rate
+   */
+  uint32_t airtimeCost(size_t len);
+
+  /**
+   * Return the largest payload (in bytes) an uplink can carry with the
+   * current data rate
+   */
+  uint8_t maxPayload();
 
   /**
    * Call the designated callback when a LoRa packet is sent
@@ -81,6 +131,33 @@ public:
    */
   void configureTTNChannels();
 
+  /**
+   * Save a snapshot of the LMIC MAC state (channels, duty cycle, ADR, RX2)
+   * on the RTC memory, before sleeping for `sleepMs` milliseconds
+   */
+  void saveState(uint32_t sleepMs);
+
+  /**
+   * Restore the LMIC MAC state saved with `saveState`, if there is a valid
+   * snapshot for the current session
+   */
+  void restoreState();
+
+  /**
+   * Release a queued frame and notify its callback
+   */
+  void releaseFrame(LoRaQueuedFrame * frame, int status, uint8_t * data, uint8_t len);
+
+  /**
+   * Pick the next frame to send, or NULL if the queue is empty
+   */
+  LoRaQueuedFrame * nextFrame();
+
+  /**
+   * Hand over the next queued frame to LMIC, if nothing is in progress
+   */
+  void dispatch();
+
 
   struct {
 
@@ -90,7 +167,7 @@ public:
     uint8_t   configured : 1;
 
     /**
-     * Pending transmission in the data buffer
+     * The `active` frame has been handed over to LMIC
      */
     uint8_t   pending : 1;
 
@@ -107,15 +184,24 @@ public:
   fnLoRaCallback joinedCb;
 
   /**
-   * Pending transmission
+   * The static frame pool backing the uplink queue
    */
-  struct {
-    const char * data;
-    size_t len;
-    unsigned long timeout_ts;
-    uint16_t timeout;
-    uint8_t retries;
-  } pending;
+  LoRaQueuedFrame queue[LORA_QUEUE_SIZE];
+
+  /**
+   * The frame currently being transmitted (valid when `flags.pending` is set)
+   */
+  LoRaQueuedFrame * active;
+
+  /**
+   * When the active transmission is considered timed out
+   */
+  unsigned long timeout_ts;
+
+  /**
+   * Sequence counter used for keeping FIFO order within the same priority
+   */
+  uint16_t queueSeq;
 
 };
 
@@ -35,6 +35,7 @@
 #include "../Config.hpp"
 #include "GPIO.hpp"
 #include "LoRa.hpp"
+#include "SPIBus.hpp"
 
 extern "C" {
   #include "user_interface.h"
@@ -50,6 +51,15 @@ extern "C" {
  */
 PowerClass Power;
 
+/**
+ * Set when the CPU wakes up from forced light sleep
+ */
+static volatile uint8_t lightSleepWoken;
+
+static void onLightSleepWakeup() {
+  lightSleepWoken = 1;
+}
+
 /**
  * Configure the power system
  */
@@ -233,7 +243,7 @@ uint8_t PowerClass::getVBusOverride() {
  */
 void PowerClass::off() {
   // Stop SPI
-  SPI.end();
+  SPIBus.end();
 
   // Turn off all peripherals
   setLoRaRadio(0);
@@ -250,3 +260,49 @@ void PowerClass::off() {
   digitalWrite(UPIN_VBUS_EN, LOW);
 
 }
+
+/**
+ * Put the CPU in forced light sleep, until the timer expires or one of the
+ * LoRa DIO lines goes high
+ */
+uint32_t PowerClass::lightSleep(uint32_t us) {
+  // Light sleep would drop the WiFi connection
+  if (state.wifi) return 0;
+
+  // The RTC clock keeps running during light sleep, use it to find out how
+  // long we actually slept (the calibration is in 1/4096th of microseconds)
+  uint32_t rtcCal = system_rtc_clock_cali_proc();
+  uint32_t rtcStart = system_get_rtc_time();
+  uint32_t usStart = micros();
+
+  // Switch from forced modem sleep to forced light sleep
+  wifi_fpm_do_wakeup();
+  wifi_fpm_close();
+  wifi_fpm_set_sleep_type(LIGHT_SLEEP_T);
+  wifi_fpm_open();
+  wifi_fpm_set_wakeup_cb(onLightSleepWakeup);
+  wifi_enable_gpio_wakeup(UPIN_RFM_DIO0, GPIO_PIN_INTR_HILEVEL);
+  wifi_enable_gpio_wakeup(UPIN_RFM_DIO1, GPIO_PIN_INTR_HILEVEL);
+
+  // The sleep only starts when the idle task gets to run
+  lightSleepWoken = 0;
+  if (wifi_fpm_do_sleep(us) == 0) {
+    for (uint32_t ms = us / 1000 + 1; ms && !lightSleepWoken; --ms) {
+      delay(1);
+    }
+  }
+  wifi_disable_gpio_wakeup();
+
+  // Back to the forced modem sleep that keeps the WiFi off
+  wifi_fpm_close();
+  wifi_set_sleep_type(MODEM_SLEEP_T);
+  wifi_fpm_open();
+  wifi_fpm_do_sleep(FPM_SLEEP_MAX_TIME);
+
+  uint32_t slept = ((uint64_t)(system_get_rtc_time() - rtcStart) * rtcCal) >> 12;
+  uint32_t counted = micros() - usStart;
+  sleepStats.count++;
+  sleepStats.time += slept;
+
+  return (slept > counted) ? (slept - counted) : 0;
+}
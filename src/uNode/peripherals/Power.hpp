@@ -65,6 +65,22 @@ public:
    */
   void off();
 
+  /**
+   * Put the CPU in forced light sleep for up to `us` microseconds, or until
+   * one of the LoRa DIO lines goes high
+   *
+   * Returns the number of microseconds that `micros()` missed while sleeping.
+   */
+  uint32_t lightSleep(uint32_t us);
+
+  /**
+   * Light sleep statistics
+   */
+  struct {
+    uint32_t  count;
+    uint32_t  time;   // Total time spent in light sleep (in microseconds)
+  } sleepStats;
+
 private:
 
   /**
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+
+#include <Arduino.h>
+#include "SPIBus.hpp"
+
+
+/**
+ * Initialize the singleton
+ */
+SPIBusClass SPIBus;
+
+
+/**
+ * Constructor
+ */
+SPIBusClass::SPIBusClass()
+  : _current( -1 ), _busC( 0 ), _busU( 0 ), _busP( 0 ) {
+  memset( _devices, 0, sizeof( _devices ) );
+}
+
+
+/**
+ * Set the chip select pin and the clock of a device
+ */
+void SPIBusClass::setDevice( uint8_t device, uint8_t csPin, uint32_t clock ) {
+  if ( device >= SPI_DEVICES ) return;
+
+  SPI.begin();
+  ::pinMode( csPin, OUTPUT );
+  ::digitalWrite( csPin, HIGH );      // Not selected.
+
+  _devices[device].csPin = csPin;
+  _devices[device].csMask = ( csPin < 16 ) ? ( 1UL << csPin ) : 0;
+  if ( _devices[device].clock != clock ) {
+    _devices[device].clock = clock;
+    _devices[device].clockRegister = 0;
+  }
+  if ( _current == device ) _current = -1;
+}
+
+
+/**
+ * Configure the bus for the device, if it isn't already, and select it
+ */
+void SPIBusClass::select( uint8_t device ) {
+#ifdef SPI1CLK
+  // Another SPI user may have changed the mode or the bit order as well as
+  // the clock, so check the whole configuration.
+  bool configured = ( SPI1C == _busC ) && ( SPI1U == _busU ) && ( SPI1P == _busP );
+  if ( !configured || ( _current != device ) || ( SPI1CLK != _devices[device].clockRegister ) ) {
+    if ( configured && _devices[device].clockRegister ) {
+      // Only the clock differs between the devices.
+      SPI1CLK = _devices[device].clockRegister;
+    } else {
+      // Let the SPI library find the divider once, and keep the result.
+      SPI.beginTransaction( SPISettings( _devices[device].clock, MSBFIRST, SPI_MODE0 ) );
+      _devices[device].clockRegister = SPI1CLK;
+      _busC = SPI1C;
+      _busU = SPI1U;
+      _busP = SPI1P;
+    }
+    _current = device;
+  }
+#else
+  SPI.beginTransaction( SPISettings( _devices[device].clock, MSBFIRST, SPI_MODE0 ) );
+#endif
+
+#ifdef GPOC
+  if ( _devices[device].csMask ) {
+    GPOC = _devices[device].csMask;
+    return;
+  }
+#endif
+  ::digitalWrite( _devices[device].csPin, LOW );
+}
+
+
+/**
+ * Deselect the device
+ */
+void SPIBusClass::deselect( uint8_t device ) {
+#ifdef GPOS
+  if ( _devices[device].csMask ) {
+    GPOS = _devices[device].csMask;
+  } else
+#endif
+  {
+    ::digitalWrite( _devices[device].csPin, HIGH );
+  }
+
+#ifndef SPI1CLK
+  SPI.endTransaction();
+#endif
+}
+
+
+/**
+ * Stop the bus
+ */
+void SPIBusClass::end() {
+  SPI.end();
+  _current = -1;
+}
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * Copyright (c) 2018 Ioannis Charalampidis
+ *
+ * This is a private, preview release of the uNode hardware abstraction library.
+ * The holder of a copy of this software and associated documentation files
+ * (the "Software") is allowed to use the Software without any obligation to
+ * create private and/or commercial projects. The Software can be obtained
+ * through the official channels of the author, including but not limited to
+ * Github and the official TLab.gr website. It is FORBIDDEN however to modify,
+ * reverse-engineer, publish, distribute, sublicense, and/or sell copies of the
+ * Software itself.
+ *
+ * The license for this file might change in a future release. The author is not
+ * obliged to announce this change through any channel but it should be included
+ * in the release notes.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *******************************************************************************/
+#ifndef SPIBUS_H
+#define SPIBUS_H
+
+#include <SPI.h>
+
+/**
+ * The chips on the SPI bus
+ */
+#define SPI_DEVICE_RADIO    0   // SX1276, through the LMIC HAL
+#define SPI_DEVICE_GPIO     1   // MCP23S08
+#define SPI_DEVICES         2
+
+/**
+ * Shares the SPI bus between the radio and the GPIO expansion chip. The bus
+ * is only re-configured when a different device than the last one is
+ * selected (or another SPI user changed the clock, mode or bit order), and
+ * the chip select lines are driven through the GPIO registers.
+ *
+ * All the devices use SPI_MODE0, MSBFIRST.
+ */
+class SPIBusClass {
+public:
+
+  /**
+   * Constructor
+   */
+  SPIBusClass();
+
+  /**
+   * Set the chip select pin and the clock of a device, and start the bus
+   */
+  void setDevice( uint8_t device, uint8_t csPin, uint32_t clock );
+
+  /**
+   * Configure the bus for the device (if needed) and select it
+   */
+  void select( uint8_t device );
+
+  /**
+   * Deselect the device. The bus stays configured for it.
+   */
+  void deselect( uint8_t device );
+
+  /**
+   * Stop the bus. The devices are re-configured on their next selection.
+   */
+  void end();
+
+private:
+
+  struct {
+    uint8_t   csPin;
+    uint32_t  csMask;         // For GPOS / GPOC, 0 on GPIO16
+    uint32_t  clock;          // Hz
+    uint32_t  clockRegister;  // SPI1CLK for the clock, 0 until known
+  } _devices[SPI_DEVICES];
+
+  int8_t _current;            // Device the bus is configured for, or -1
+  uint32_t _busC;             // SPI1C, SPI1U and SPI1P for SPI_MODE0, MSBFIRST,
+  uint32_t _busU;             // 0 until known
+  uint32_t _busP;
+
+};
+
+/**
+ * Singleton of the SPIBusClass, available as `SPIBus`
+ */
+extern SPIBusClass SPIBus;
+
+#endif
@@ -23,18 +23,88 @@
  *
  *******************************************************************************/
 #include "Wire.hpp"
+#include "GPIO.hpp"
+#include "Power.hpp"
+#include "../../uNodeOpen.hpp"
+
+// Phases of a queued transaction
+#define WIRE_PHASE_START      0   // Start, and address for writing
+#define WIRE_PHASE_WRITE      1
+#define WIRE_PHASE_RESTART    2   // (Repeated) start, and address for reading
+#define WIRE_PHASE_READ       3
 
 /**
  * Singleton factory
  */
 GPIOSoftWire Wire;
 
+/**
+ * Write a byte with the I2C engine of the GPIO expansion
+ */
+static SoftWire::result_t gpioWriteByte(const SoftWire * p, uint8_t data) {
+  Power.setGPIO(1);
+  return (SoftWire::result_t)GPIO.i2cWrite(p->getSda() - 100, p->getScl() - 100, data,
+                                           p->getDelay_us(), p->getTimeout_ms());
+}
+
+/**
+ * Read a byte with the I2C engine of the GPIO expansion
+ */
+static SoftWire::result_t gpioReadByte(const SoftWire * p, uint8_t &data, bool sendAck) {
+  Power.setGPIO(1);
+  return (SoftWire::result_t)GPIO.i2cRead(p->getSda() - 100, p->getScl() - 100, &data, sendAck,
+                                          p->getDelay_us(), p->getTimeout_ms());
+}
+
+/**
+ * Release a native pin, letting it float high (input, pull-up set by begin)
+ */
+template <uint8_t PIN> static void nativeHigh(const SoftWire * p) {
+  GPEC = (1 << PIN);
+}
+
+/**
+ * Force a native pin low (output, with the output latch kept low)
+ */
+template <uint8_t PIN> static void nativeLow(const SoftWire * p) {
+  GPOC = (1 << PIN);
+  GPES = (1 << PIN);
+}
+
+/**
+ * Read a native pin
+ */
+template <uint8_t PIN> static uint8_t nativeRead(const SoftWire * p) {
+  return (GPI & (1 << PIN)) ? HIGH : LOW;
+}
+
+/**
+ * The line functions of the native pins, with the pin masks resolved at
+ * compile time. GPIO16 has different registers, and goes through uNode.
+ */
+typedef struct {
+  void (*low)(const SoftWire *);
+  void (*high)(const SoftWire *);
+  uint8_t (*read)(const SoftWire *);
+} NativeLine;
+
+#define NATIVE_LINE(pin) { nativeLow<pin>, nativeHigh<pin>, nativeRead<pin> }
+#define NATIVE_LINES 16
+
+static const NativeLine nativeLines[NATIVE_LINES] = {
+  NATIVE_LINE(0),  NATIVE_LINE(1),  NATIVE_LINE(2),  NATIVE_LINE(3),
+  NATIVE_LINE(4),  NATIVE_LINE(5),  NATIVE_LINE(6),  NATIVE_LINE(7),
+  NATIVE_LINE(8),  NATIVE_LINE(9),  NATIVE_LINE(10), NATIVE_LINE(11),
+  NATIVE_LINE(12), NATIVE_LINE(13), NATIVE_LINE(14), NATIVE_LINE(15)
+};
+
 /**
  * Begin method that also configures the SDA/SCL ports
  */
 void GPIOSoftWire::begin(uint8_t sda, uint8_t scl) {
   setSda(sda);
   setScl(scl);
+  selectDrivers();
   SoftWire::begin();
 }
 
@@ -42,5 +112,186 @@ void GPIOSoftWire::begin(uint8_t sda, uint8_t scl) {
  * Begin method without pins
  */
 void GPIOSoftWire::begin(void) {
+  selectDrivers();
   SoftWire::begin();
 }
+
+/**
+ * Restore the pins to inputs, also removing the pullups of the native pins
+ */
+void GPIOSoftWire::end(void) {
+  SoftWire::end();
+  selectDrivers();
+}
+
+/**
+ * The SCL frequency of the last byte
+ */
+uint32_t GPIOSoftWire::getClock(void) {
+  if ((getSda() >= 100) && (getScl() >= 100)) {
+    return GPIO.i2cClock();
+  }
+  return 0;
+}
+
+/**
+ * Drive the native pins through the registers, and use the I2C engine of the
+ * GPIO expansion if both pins are there
+ */
+void GPIOSoftWire::selectDrivers(void) {
+  uint8_t sda = getSda();
+  uint8_t scl = getScl();
+
+  if (sda < NATIVE_LINES) {
+    ::pinMode(sda, getInputMode());
+    setSetSdaLow(nativeLines[sda].low);
+    setSetSdaHigh(nativeLines[sda].high);
+    setReadSda(nativeLines[sda].read);
+  } else {
+    setSetSdaLow(SoftWire::sdaLow);
+    setSetSdaHigh(SoftWire::sdaHigh);
+    setReadSda(SoftWire::readSda);
+  }
+
+  if (scl < NATIVE_LINES) {
+    ::pinMode(scl, getInputMode());
+    setSetSclLow(nativeLines[scl].low);
+    setSetSclHigh(nativeLines[scl].high);
+    setReadScl(nativeLines[scl].read);
+  } else {
+    setSetSclLow(SoftWire::sclLow);
+    setSetSclHigh(SoftWire::sclHigh);
+    setReadScl(SoftWire::readScl);
+  }
+
+  if ((sda >= 100) && (scl >= 100)) {
+    setWriteByte(gpioWriteByte);
+    setReadByte(gpioReadByte);
+  } else {
+    setWriteByte(NULL);
+    setReadByte(NULL);
+  }
+}
+
+/**
+ * The uNode.step() handler of the queue
+ */
+static void wireStep() {
+  Wire.step();
+}
+
+/**
+ * Copy a transaction in the queue
+ */
+int GPIOSoftWire::queueTransaction(uint8_t address, const uint8_t * txData, uint8_t txLen,
+                                   uint8_t rxLen, fnWireCallback whenDone) {
+  if ((_queueCount >= WIRE_QUEUE_SIZE) || (txLen > WIRE_QUEUE_DATA) || (rxLen > WIRE_QUEUE_DATA)) {
+    return -1;
+  }
+  if (uNode.addStepHandler(wireStep) < 0) {
+    return -1;
+  }
+
+  WireQueuedTransaction * t = &_queue[(_queueHead + _queueCount) % WIRE_QUEUE_SIZE];
+  memcpy(t->data, txData, txLen);
+  t->address = address;
+  t->txLen = txLen;
+  t->rxLen = rxLen;
+  t->cb = whenDone;
+
+  if (_queueCount++ == 0) {
+    _phase = WIRE_PHASE_START;
+    _index = 0;
+  }
+  return 0;
+}
+
+/**
+ * Number of queued transactions
+ */
+uint8_t GPIOSoftWire::pending(void) {
+  return _queueCount;
+}
+
+/**
+ * Advance the queued transactions a byte at a time, until the time slice is over
+ */
+void GPIOSoftWire::step(void) {
+  uint32_t startTime = micros();
+
+  while (_queueCount) {
+    WireQueuedTransaction * t = &_queue[_queueHead];
+    result_t r;
+
+    switch (_phase) {
+      case WIRE_PHASE_START:
+        if ((t->txLen == 0) && (t->rxLen != 0)) {
+          _phase = WIRE_PHASE_RESTART;
+          continue;
+        }
+        r = startWrite(t->address);
+        if (r != ack) {
+          finish(r == nack ? 2 : 4, 0);
+          break;
+        }
+        _phase = WIRE_PHASE_WRITE;
+        break;
+
+      case WIRE_PHASE_WRITE:
+        if (_index < t->txLen) {
+          r = llWrite(t->data[_index++]);
+          if (r != ack) {
+            finish(r == nack ? 3 : 4, 0);
+          }
+        } else if (t->rxLen) {
+          _phase = WIRE_PHASE_RESTART;
+          continue;
+        } else {
+          finish(0, 0);
+        }
+        break;
+
+      case WIRE_PHASE_RESTART:
+        r = t->txLen ? repeatedStartRead(t->address) : startRead(t->address);
+        if (r != ack) {
+          finish(r == nack ? 2 : 4, 0);
+          break;
+        }
+        _phase = WIRE_PHASE_READ;
+        _index = 0;
+        break;
+
+      case WIRE_PHASE_READ:
+        r = llRead(t->data[_index], _index != (t->rxLen - 1));
+        if (r != ack) {
+          finish(4, _index);
+        } else if (++_index == t->rxLen) {
+          finish(0, _index);
+        }
+        break;
+    }
+
+    if (micros() - startTime >= WIRE_STEP_SLICE) {
+      break;
+    }
+  }
+}
+
+/**
+ * Stop the transaction at the head of the queue, call its callback with the
+ * `len` bytes read and remove it. Transactions queued from the callback go
+ * after it.
+ */
+void GPIOSoftWire::finish(int status, uint8_t len) {
+  WireQueuedTransaction * t = &_queue[_queueHead];
+
+  stop();
+  if (t->cb) {
+    t->cb(status, t->data, len);
+  }
+
+  _queueHead = (_queueHead + 1) % WIRE_QUEUE_SIZE;
+  _queueCount--;
+  _phase = WIRE_PHASE_START;
+  _index = 0;
+}
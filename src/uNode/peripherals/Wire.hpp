@@ -32,7 +32,45 @@
 #include "../../vendor/SoftWire/SoftWire.h"
 
 /**
- * A SoftWire implementation using the seamless GPIO expansion middleware
+ * Number of I2C transactions that can be queued, and the bytes each one can
+ * write or read. Can be overridden at build time.
+ */
+#ifndef WIRE_QUEUE_SIZE
+#define WIRE_QUEUE_SIZE       4
+#endif
+#ifndef WIRE_QUEUE_DATA
+#define WIRE_QUEUE_DATA       16
+#endif
+
+/**
+ * Longest time (micro seconds) a queued transaction runs on every step. It
+ * always gets at least one byte.
+ */
+#ifndef WIRE_STEP_SLICE
+#define WIRE_STEP_SLICE       1000
+#endif
+
+/**
+ * The callback function to use for letting the user know when a queued
+ * transaction is done. The status is that of `endTransmission()`, and the
+ * data are the bytes read.
+ */
+typedef void(*fnWireCallback)(int status, uint8_t *data, uint8_t len);
+
+/**
+ * A transaction waiting in the I2C queue
+ */
+struct WireQueuedTransaction {
+  uint8_t             data[WIRE_QUEUE_DATA];  // Bytes to write, then bytes read
+  uint8_t             address;
+  uint8_t             txLen;
+  uint8_t             rxLen;
+  fnWireCallback      cb;
+};
+
+/**
+ * A SoftWire implementation using the seamless GPIO expansion middleware.
+ * Native ESP8266 pins are driven through the GPIO registers directly.
  */
 class GPIOSoftWire: public SoftWire {
 public:
@@ -40,7 +78,7 @@ public:
   /**
    * Default factory for the SoftWire singleton
    */
-  GPIOSoftWire(): SoftWire(0,0) { };
+  GPIOSoftWire(): SoftWire(0,0), _queueHead(0), _queueCount(0), _phase(0), _index(0) { };
 
   /**
    * Begin methods with and without pin configuration
@@ -48,6 +86,52 @@ public:
   void begin(uint8_t sda, uint8_t scl);
   void begin(void);
 
+  /**
+   * Restore the pins to inputs, without pullups
+   */
+  void end(void);
+
+  /**
+   * The SCL frequency (Hz) of the last byte. When both pins are on the GPIO
+   * expansion, the bytes are clocked by its I2C engine, streaming every byte
+   * in one SPI transaction. Otherwise this is 0.
+   */
+  uint32_t getClock(void);
+
+  /**
+   * Queue a transaction that writes `txLen` bytes to the device and then
+   * reads `rxLen` bytes from it (with a repeated start), calling `whenDone`
+   * at the end. The transactions run in the background from `uNode.step()`,
+   * a byte at a time and up to `WIRE_STEP_SLICE` micro seconds per step, so
+   * they don't hold up LoRa. The bus is released between steps with SCL low.
+   *
+   * Don't use the blocking functions while transactions are pending.
+   * Returns -1 if the queue is full or the data too long.
+   */
+  int queueTransaction(uint8_t address, const uint8_t * txData, uint8_t txLen,
+                       uint8_t rxLen, fnWireCallback whenDone = NULL);
+
+  /**
+   * Number of queued transactions, including the running one
+   */
+  uint8_t pending(void);
+
+  /**
+   * Run the queued transactions for one time slice. Called by `uNode.step()`.
+   */
+  void step(void);
+
+private:
+
+  void selectDrivers(void);
+  void finish(int status, uint8_t len);
+
+  WireQueuedTransaction _queue[WIRE_QUEUE_SIZE];
+  uint8_t _queueHead;
+  uint8_t _queueCount;
+  uint8_t _phase;             // Of the transaction at the head
+  uint8_t _index;             // Byte of the phase
+
 };
 
 /**
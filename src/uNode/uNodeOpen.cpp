@@ -44,6 +44,11 @@ extern "C" {
  */
 __attribute__((weak)) uNodeClassOpen uNode;
 
+/**
+ * Background drivers called from step()
+ */
+static fnStepCallback stepHandlers[UNODE_STEP_HANDLERS];
+
 /**
  * Initialize the micro-node hardware
  */
@@ -93,12 +98,29 @@ void uNodeClassOpen::setup() {
  * Update micro-node interfaces
  */
 void uNodeClassOpen::step() {
+  for (uint8_t i = 0; (i < UNODE_STEP_HANDLERS) && stepHandlers[i]; ++i) {
+    stepHandlers[i]();
+  }
   LoRa.step();
   if (system_config.undervoltageProtection.disableThreshold != 0xFFFF) {
     undervoltageProtect();
   }
 }
 
+/**
+ * Call a background driver on every step
+ */
+int uNodeClassOpen::addStepHandler(fnStepCallback handler) {
+  for (uint8_t i = 0; i < UNODE_STEP_HANDLERS; ++i) {
+    if (stepHandlers[i] == handler) return 0;
+    if (stepHandlers[i] == NULL) {
+      stepHandlers[i] = handler;
+      return 0;
+    }
+  }
+  return -1;
+}
+
 /**
  * Put all peripherals on idle
  */
@@ -124,7 +146,8 @@ void uNodeClassOpen::standby(STANDBY_MODE_t mode) {
 /**
  * Send a packet over the LoRa network
  */
-void uNodeClassOpen::sendLoRa(const char * data, size_t size, fnLoRaDataCallback whenDone) {
+void uNodeClassOpen::sendLoRa(const char * data, size_t size, fnLoRaDataCallback whenDone,
+                              LORA_PRIORITY_t priority, uint32_t ttl) {
   if (system_config.lora.mode == LORA_DISABLED) {
     return;
   }
@@ -135,16 +158,41 @@ void uNodeClassOpen::sendLoRa(const char * data, size_t size, fnLoRaDataCallback
   // Define the callback function to trigger when the transmission is completed
   if (whenDone != nullptr) LoRa.whenSent(whenDone);
 
-  // Managed transmission is going to retry 10 times, using 10 seconds interval
-  // between transmissions
+  // Queue a managed transmission, that is going to be re-tried `tx_retries`
+  // times, using `tx_timeout` interval between transmissions
   LoRa.sendManaged(data, size, system_config.lora.tx_retries,
-                   system_config.lora.tx_timeout);
+                   system_config.lora.tx_timeout, priority, ttl);
+}
+
+/**
+ * Return the number of milliseconds until the next LoRa uplink can go out
+ */
+uint32_t uNodeClassOpen::nextTxTime() {
+  return LoRa.nextTxTime();
+}
+
+/**
+ * Return the airtime (in milliseconds) of sending `len` bytes over LoRa
+ */
+uint32_t uNodeClassOpen::airtimeCost(size_t len) {
+  return LoRa.airtimeCost(len);
+}
+
+/**
+ * Return the largest payload (in bytes) that can be sent over LoRa
+ */
+uint8_t uNodeClassOpen::maxPayload() {
+  return LoRa.maxPayload();
 }
 
 /**
  * Enter deep sleep
  */
 void uNodeClassOpen::deepSleep(const uint16_t seconds) {
+  // Keep the LoRa MAC state, accounting for the time we are going to sleep
+  LoRa.saveState(seconds * 1000UL);
+
+  // This also shuts LoRa down, flushing its session to the RTC memory
   Power.off();
   logDebug("Sleeping for %d sec", seconds);
   Serial.flush();
@@ -199,6 +247,84 @@ int uNodeClassOpen::timeHalfPulse(uint8_t pin) {
   }
 }
 
+/**
+ * Capture the edges on a pin (expansion pins only)
+ */
+uint16_t uNodeClassOpen::captureEdges(uint8_t pin, uint32_t * timestamps, uint16_t maxEdges,
+                                      uint32_t window, uint8_t * level) {
+  if (pin < 100) {  // Physical pin
+    return 0;
+  } else { // Expansion pin
+    Power.setGPIO(1);
+    return GPIO.captureEdges(pin - 100, timestamps, maxEdges, window, level);
+  }
+}
+
+/**
+ * Capture the changes on the masked expansion pins
+ */
+uint16_t uNodeClassOpen::capturePort(uint8_t mask, uint32_t * timestamps, uint8_t * states,
+                                     uint16_t maxChanges, uint32_t window, uint8_t * initial) {
+  Power.setGPIO(1);
+  return GPIO.capturePort(mask, timestamps, states, maxChanges, window, initial);
+}
+
+/**
+ * Read all the expansion pins at once
+ */
+uint8_t uNodeClassOpen::readPort() {
+  Power.setGPIO(1);
+  return GPIO.readPort();
+}
+
+/**
+ * Write the masked bits of value on the expansion pins
+ */
+void uNodeClassOpen::writePort(uint8_t mask, uint8_t value) {
+  Power.setGPIO(1);
+  GPIO.writePort(mask, value);
+}
+
+/**
+ * Set the direction of the masked expansion pins
+ */
+void uNodeClassOpen::pinModePort(uint8_t mask, uint8_t mode) {
+  Power.setGPIO(1);
+  GPIO.pinModePort(mask, mode);
+}
+
+/**
+ * Start collecting changes on the expansion pins
+ */
+void uNodeClassOpen::beginBatch() {
+  Power.setGPIO(1);
+  GPIO.beginBatch();
+}
+
+/**
+ * Write the collected changes on the expansion pins
+ */
+void uNodeClassOpen::commitBatch() {
+  Power.setGPIO(1);
+  GPIO.commitBatch();
+}
+
+/**
+ * Watch the masked expansion pins for changes
+ */
+void uNodeClassOpen::watchPort(uint8_t mask, uint8_t intPin) {
+  Power.setGPIO(1);
+  GPIO.watchPort(mask, intPin);
+}
+
+/**
+ * Report the watched expansion pins that changed
+ */
+uint8_t uNodeClassOpen::portChanges(uint8_t * state) {
+  Power.setGPIO(1);
+  return GPIO.portChanges(state);
+}
+
 /**
  * Enable or Disable the VBus explicitly
  */
@@ -206,6 +332,13 @@ void uNodeClassOpen::enablePeripherals(const uint8_t enabled) {
   Power.setVBusOverride(enabled);
 }
 
+/**
+ * Enable or Disable light sleep while waiting for the LoRa RX windows
+ */
+void uNodeClassOpen::enableLightSleep(const uint8_t enabled) {
+  system_config.lora.light_sleep = enabled;
+}
+
 /**
  * Blink the built-in led
  */
@@ -41,6 +41,7 @@
 #define RTCMEM_SLOT_BOOTFLAGS   RTCMEM_MAX_SLOT - 1   // 1-slot wide
 #define RTCMEM_SLOT_LORAPERSIST RTCMEM_MAX_SLOT - 13  // 12-slot wide
 #define RTCMEM_SLOT_SKETCHID    RTCMEM_MAX_SLOT - 14  // 1-slot wide
+#define RTCMEM_SLOT_LORAMAC     RTCMEM_MAX_SLOT - 52  // 38-slot wide
 
 /**
  * A flag that denotes that the system went to sleep because of undervoltage
@@ -148,5 +149,83 @@ template <typename T> uint8_t rtcMemRead(const uint8_t slot, const uint8_t offse
   return sizeof(T);
 }
 
+/**
+ * Keeps a structure persisted on the RTC memory, writing only what changed
+ *
+ * The structure is modified through `.value` and written with `.flush()`,
+ * which compares it against a shadow copy of the RTC memory contents and only
+ * writes the 32-bit words that differ. This way multiple modifications can be
+ * coalesced into a single (and smaller) write.
+ */
+template <typename T> class RTCMemPersist {
+public:
+
+  RTCMemPersist(const uint8_t slot) : slot(slot), synced(0) { }
+
+  /**
+   * Read the structure from the RTC memory
+   *
+   * Returns the number of bytes read.
+   */
+  uint8_t load() {
+    ESP.rtcUserMemoryRead(slot, shadow, sizeof(shadow));
+    memcpy(words, shadow, sizeof(shadow));
+    synced = 1;
+    return sizeof(T);
+  }
+
+  /**
+   * Write the words that changed since the last `load` or `flush`. Consecutive
+   * changed words are written with a single call.
+   *
+   * Returns the number of words written.
+   */
+  uint8_t flush() {
+    uint8_t written = 0;
+    uint8_t i = 0;
+
+    while (i < WORDS) {
+      if (synced && (words[i] == shadow[i])) {
+        ++i;
+        continue;
+      }
+
+      // Find the end of the run of changed words
+      uint8_t first = i;
+      while ((i < WORDS) && (!synced || (words[i] != shadow[i]))) {
+        shadow[i] = words[i];
+        ++i;
+      }
+
+      ESP.rtcUserMemoryWrite(slot + first, &words[first], (i - first) * sizeof(uint32_t));
+      written += i - first;
+    }
+
+    synced = 1;
+    return written;
+  }
+
+  /**
+   * Forget about the RTC memory contents, so the next `flush` writes everything
+   */
+  void invalidate() {
+    synced = 0;
+  }
+
+  /**
+   * The persisted value
+   */
+  union {
+    T         value;
+    uint32_t  words[(sizeof(T) + 3) / 4];
+  };
+
+private:
+  static const uint8_t WORDS = (sizeof(T) + 3) / 4;
+  uint32_t shadow[WORDS];
+  uint8_t slot;
+  uint8_t synced;
+
+};
 
 #endif
@@ -56,20 +56,35 @@ public:
    */
   void step();
 
+  /**
+   * Call `handler` on every `step()`, for drivers that work in the background.
+   * Adding the same handler again does nothing. Returns -1 if there is no room
+   * for more handlers.
+   */
+  int addStepHandler(fnStepCallback handler);
+
   /**
    * Send a packet over the LoRa network
+   *
+   * The packet is copied into the uplink queue and sent from `step()` as soon
+   * as the radio is free. Frames with higher `priority` are sent first, and if
+   * `ttl` is non-zero the frame is dropped when not sent within `ttl` ms.
    */
-  void sendLoRa(const char * data, size_t size, fnLoRaDataCallback whenDone = nullptr);
+  void sendLoRa(const char * data, size_t size, fnLoRaDataCallback whenDone = nullptr,
+                LORA_PRIORITY_t priority = LORA_PRIORITY_NORMAL, uint32_t ttl = 0);
 
   /**
    * Send a structure over LoRa
    */
   template <typename T>
-  void sendLoRa(const T& data, fnLoRaDataCallback whenDone = nullptr) {
+  void sendLoRa(const T& data, fnLoRaDataCallback whenDone = nullptr,
+                LORA_PRIORITY_t priority = LORA_PRIORITY_NORMAL, uint32_t ttl = 0) {
     this->sendLoRa(
       static_cast<const char*>(static_cast<const void*>(&data)),
       sizeof(T),
-      whenDone
+      whenDone,
+      priority,
+      ttl
     );
   }
 
@@ -77,14 +92,43 @@ public:
    * Send a structure over LoRa
    */
   template <typename T>
-  void sendLoRa(const T* data, fnLoRaDataCallback whenDone = nullptr) {
+  void sendLoRa(const T* data, fnLoRaDataCallback whenDone = nullptr,
+                LORA_PRIORITY_t priority = LORA_PRIORITY_NORMAL, uint32_t ttl = 0) {
     this->sendLoRa(
       static_cast<const char*>(static_cast<const void*>(data)),
       sizeof(T),
-      whenDone
+      whenDone,
+      priority,
+      ttl
     );
   }
 
+  /**
+   * Return the number of milliseconds until the next LoRa uplink can go out,
+   * according to the duty-cycle limitations of the LoRa bands
+   *
+   * `uNode.deepSleep()` keeps the duty-cycle state of the bands (with the
+   * time spent sleeping deducted) in the RTC memory, and it's restored when
+   * LoRa starts again. It is lost on a cold boot (power-up or any reset other
+   * than waking from `uNode.deepSleep()`), without a LoRa session, or if the
+   * snapshot fails its CRC or version check. LMIC then starts with all the
+   * bands available, so in these cases make sure you wait at least this long
+   * before sending again.
+   */
+  uint32_t nextTxTime();
+
+  /**
+   * Return the airtime (in milliseconds) of sending `len` bytes over LoRa
+   * using the current data rate
+   */
+  uint32_t airtimeCost(size_t len);
+
+  /**
+   * Return the largest payload (in bytes) that can be sent over LoRa using
+   * the current data rate
+   */
+  uint8_t maxPayload();
+
   /**
    * Connect to the access point with the given name
    *
@@ -126,6 +170,57 @@ public:
    * Time a half-pulse on a pin (max 500 microseconds)
    */
   int timeHalfPulse(uint8_t pin);
+
+  /**
+   * Capture the edges on an expansion pin for `window` microseconds, or until
+   * `maxEdges` timestamps (in microseconds from the start) are captured, and
+   * the level at the start in `level`. Returns the number of edges.
+   */
+  uint16_t captureEdges(uint8_t pin, uint32_t * timestamps, uint16_t maxEdges,
+                        uint32_t window, uint8_t * level = NULL);
+
+  /**
+   * Capture the changes on all the expansion pins selected by `mask` at once,
+   * storing the timestamp and the port state of every change, and the port
+   * state at the start in `initial`. Returns the number of changes.
+   */
+  uint16_t capturePort(uint8_t mask, uint32_t * timestamps, uint8_t * states,
+                       uint16_t maxChanges, uint32_t window, uint8_t * initial = NULL);
+
+  /**
+   * Read all the expansion pins at once (bit 0 is `D2`, bit 7 is `D9`)
+   */
+  uint8_t readPort();
+
+  /**
+   * Write the bits of `value` selected by `mask` on the expansion pins
+   */
+  void writePort(uint8_t mask, uint8_t value);
+
+  /**
+   * Set the direction of the expansion pins selected by `mask`
+   */
+  void pinModePort(uint8_t mask, uint8_t mode);
+
+  /**
+   * Collect the `pinMode`, `digitalWrite`, `writePort` and `pinModePort`
+   * changes on the expansion pins, and write them to the GPIO chip at once
+   * on `commitBatch()`
+   */
+  void beginBatch();
+  void commitBatch();
+
+  /**
+   * Watch the expansion pins selected by `mask` for changes. If the INT line
+   * of the GPIO chip is wired to an ESP8266 pin, pass it as `intPin`.
+   */
+  void watchPort(uint8_t mask, uint8_t intPin = 0xff);
+
+  /**
+   * The watched expansion pins that changed since the last call, as a mask,
+   * with their state in `state`. This replaces polling with `digitalRead()`.
+   */
+  uint8_t portChanges(uint8_t * state = NULL);
   
   /**
    * Put all or some peripherals on standby
@@ -142,6 +237,13 @@ public:
    */
   void enablePeripherals(const uint8_t enabled = 1);
 
+  /**
+   * Enable or Disable light sleep while waiting for the LoRa RX windows
+   *
+   * When enabled, `step()` blocks until the next LoRa event is due.
+   */
+  void enableLightSleep(const uint8_t enabled = 1);
+
   /**
    * Blink the built-in ESP8266 LED
    *